@@ -0,0 +1,307 @@
+/**
+ * @file bench.c
+ *
+ * @brief
+ * Cycle-count benchmark for the ATmega168 libraries. Meant to be run under simavr
+ * with "make bench", not flashed to a real device.
+ *
+ * Timer1 is left free-running at F_CPU (no prescaler) and read before and after
+ * each operation, so every reading is in CPU cycles. The cost of reading the
+ * timer itself is measured once and subtracted. Results are printed over the
+ * UART as "BENCH <key> <value>" lines which the Makefile collects into
+ * bench/results.txt and compares against bench/baseline.txt.
+ */
+
+#ifndef F_CPU
+#define F_CPU 8000000UL //assumes MCU fuses configured for 8MHz system clock
+#endif
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "CircularBuffer.h"
+#include "frame.h"
+#include "fsm.h"
+#include "ring.h"
+#include "timer.h"
+#include "uart.h"
+
+#define BAUD       9600
+#define ITERATIONS 200
+
+//cycles the core needs to respond to an interrupt (4) plus the jmp stored
+//in the vector table (3). Added on top of the measured ISR execution time.
+#define IRQ_ENTRY_CYCLES 7
+
+//compiler barrier, keeps the timer reads on either side of the measured code
+#define BARRIER() __asm__ __volatile__("" ::: "memory")
+
+//ISR vectors defined in the drivers, called directly to time them
+extern void TIMER0_COMPA_vect(void);
+extern void USART_RX_vect(void);
+
+RING_DEFINE(bench_ring, uint8_t, CBUF_SIZE)
+
+struct result
+{
+	uint32_t total;
+	uint16_t max;
+};
+
+static uint16_t overhead;
+
+static inline uint16_t cycles_now(void)
+{
+	BARRIER();
+	uint16_t now = TCNT1;
+	BARRIER();
+	return now;
+}
+
+static void record(struct result * r, uint16_t start, uint16_t stop)
+{
+	uint16_t cycles = (uint16_t)(stop - start) - overhead;
+
+	r->total += cycles;
+	if (cycles > r->max)
+	{
+		r->max = cycles;
+	}
+}
+
+static void print_u16(uint16_t value)
+{
+	char digits[5];
+	uint8_t n = 0;
+
+	do
+	{
+		digits[n++] = '0' + (value % 10);
+		value /= 10;
+	} while (value);
+
+	while (n)
+	{
+		uart_send(digits[--n]);
+	}
+}
+
+static void print_line(const char * key, uint16_t value)
+{
+	const char * prefix = "BENCH ";
+
+	while (*prefix)
+	{
+		uart_send(*prefix++);
+	}
+	while (*key)
+	{
+		uart_send(*key++);
+	}
+	uart_send(' ');
+	print_u16(value);
+	uart_send('\n');
+}
+
+static void report(const char * key_avg, const char * key_max, struct result * r)
+{
+	print_line(key_avg, (uint16_t)(r->total / ITERATIONS));
+	print_line(key_max, r->max);
+}
+
+static void calibrate(void)
+{
+	uint16_t start = cycles_now();
+	uint16_t stop  = cycles_now();
+
+	overhead = stop - start;
+}
+
+static void bench_circular_buffer(void)
+{
+	static TYPE storage[CBUF_SIZE];
+	struct result put = {0, 0};
+	struct result get = {0, 0};
+	cbuf_handle_t cbuf = circular_buf_init(storage, CBUF_SIZE);
+	TYPE value;
+
+	//writes run past capacity so the overwrite path is included in the max
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		uint16_t start = cycles_now();
+		circular_buf_put(cbuf, (TYPE)i);
+		record(&put, start, cycles_now());
+	}
+
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		uint16_t start = cycles_now();
+		circular_buf_get(cbuf, &value);
+		record(&get, start, cycles_now());
+	}
+
+	circular_buf_free(cbuf);
+
+	report("cycles.circular_buf_put.avg", "cycles.circular_buf_put.max", &put);
+	report("cycles.circular_buf_get.avg", "cycles.circular_buf_get.max", &get);
+}
+
+static void bench_ring(void)
+{
+	static bench_ring_t ring;
+	struct result put = {0, 0};
+	struct result get = {0, 0};
+	uint8_t value;
+
+	bench_ring_reset(&ring);
+
+	//same access pattern as bench_circular_buffer() for comparison
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		uint16_t start = cycles_now();
+		bench_ring_push(&ring, (uint8_t)i);
+		record(&put, start, cycles_now());
+	}
+
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		uint16_t start = cycles_now();
+		bench_ring_get(&ring, &value);
+		record(&get, start, cycles_now());
+	}
+
+	report("cycles.ring_push.avg", "cycles.ring_push.max", &put);
+	report("cycles.ring_get.avg", "cycles.ring_get.max", &get);
+}
+
+static void bench_isr_handlers(void)
+{
+	struct result rx    = {0, 0};
+	struct result timer = {0, 0};
+
+	//short period so the reload branch is hit several times
+	timer_init(10);
+
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		uint16_t start = cycles_now();
+		uart_rx_complete_ISR();
+		record(&rx, start, cycles_now());
+	}
+
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		uint16_t start = cycles_now();
+		TimerISR();
+		record(&timer, start, cycles_now());
+	}
+
+	uart_flush();
+
+	report("cycles.uart_rx_complete_ISR.avg", "cycles.uart_rx_complete_ISR.max", &rx);
+	report("cycles.TimerISR.avg", "cycles.TimerISR.max", &timer);
+}
+
+static void bench_frame_parser(void)
+{
+	static const uint8_t command[] = {FRAME_SOF, FRAME_CMD_SAMPLE_RATE, 4, 50, 0, 0xE8, 3,
+	                                  (uint8_t)(FRAME_CMD_SAMPLE_RATE + 4 + 50 + 0xE8 + 3)};
+	struct result byte = {0, 0};
+	struct frame_msg msg;
+	uint16_t n = 0;
+
+	//whole frames, so every parser state and the queue insert are included
+	while (n < ITERATIONS)
+	{
+		for (uint8_t i = 0; i < sizeof(command) && n < ITERATIONS; ++i, ++n)
+		{
+			uint16_t start = cycles_now();
+			frame_receive_ISR(command[i]);
+			record(&byte, start, cycles_now());
+		}
+		while (frame_receive(&msg) == SUCCESS);
+	}
+
+	report("cycles.frame_receive_ISR.avg", "cycles.frame_receive_ISR.max", &byte);
+}
+
+static void bench_isr_vectors(void)
+{
+	struct result rx    = {0, 0};
+	struct result timer = {0, 0};
+
+	//vectors end in reti, which sets the global interrupt flag again
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		cli();
+		uint16_t start = cycles_now();
+		USART_RX_vect();
+		uint16_t stop = cycles_now();
+		cli();
+		record(&rx, start, stop);
+
+		start = cycles_now();
+		TIMER0_COMPA_vect();
+		stop = cycles_now();
+		cli();
+		record(&timer, start, stop);
+	}
+
+	uart_flush();
+
+	report("cycles.USART_RX_vect.avg", "cycles.USART_RX_vect.max", &rx);
+	report("cycles.TIMER0_COMPA_vect.avg", "cycles.TIMER0_COMPA_vect.max", &timer);
+
+	//interrupts do not nest, so the worst case for any interrupt is waiting for
+	//the longest running ISR to finish and then being dispatched itself
+	uint16_t worst = (rx.max > timer.max) ? rx.max : timer.max;
+	print_line("cycles.isr_latency_worst", worst + IRQ_ENTRY_CYCLES);
+}
+
+static void bench_fsm(void)
+{
+	struct result step = {0, 0};
+
+	fsm_init();
+
+	//alternate between open and closed readings to walk every transition
+	for (uint16_t i = 0; i < ITERATIONS; ++i)
+	{
+		uint8_t adc = ((i / 8) % 2) ? (THRESHOLD + 20) : (THRESHOLD - 20);
+		uint16_t start = cycles_now();
+		fsm_tick(adc, 50);
+		record(&step, start, cycles_now());
+	}
+
+	report("cycles.fsm_tick.avg", "cycles.fsm_tick.max", &step);
+}
+
+int main(void)
+{
+	uart_init(BAUD);
+	cli();
+
+	//Timer1 free-running, clock select: internal clock, no prescaler
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);
+
+	calibrate();
+
+	bench_circular_buffer();
+	bench_ring();
+	bench_isr_handlers();
+	bench_frame_parser();
+	bench_isr_vectors();
+	bench_fsm();
+
+	//simavr stops the simulation when the core sleeps with interrupts off
+	cli();
+	sleep_enable();
+	sleep_cpu();
+
+	return 0;
+}
+
+/*** end of file ***/
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Compare benchmark results against the committed baseline.
+#
+# usage: compare.sh <baseline> <results>
+#
+# Both files hold "<key> <value>" lines. Every key in the baseline must be present
+# in the results and must not have grown, and every result must have a baseline
+# entry, otherwise the script exits non-zero. An empty baseline fails as well: a
+# key that is not in the baseline cannot be checked for a regression.
+# Lines starting with '#' are ignored. Record a new baseline with "make bench-baseline".
+
+baseline=$1
+results=$2
+
+awk '
+	BEGIN { printf "  %-40s %8s %8s\n", "key", "baseline", "current" }
+	/^#/ || NF == 0 { next }
+	FILENAME == ARGV[1] { base[$1] = $2; next }
+	{
+		seen[$1] = 1
+		if (!($1 in base))
+		{
+			printf "  %-40s %8s %8d  NO BASELINE\n", $1, "-", $2
+			unchecked++
+			next
+		}
+		status = ($2 > base[$1]) ? "REGRESSION" : ""
+		if (status != "") failed++
+		printf "  %-40s %8d %8d  %s\n", $1, base[$1], $2, status
+	}
+	END {
+		for (key in base)
+		{
+			if (!(key in seen))
+			{
+				printf "  %-40s %8d %8s  MISSING\n", key, base[key], "-"
+				failed++
+			}
+		}
+		if (unchecked)
+		{
+			printf "\nbench: %d key(s) not in the baseline, record one with \"make bench-baseline\"\n", unchecked
+		}
+		if (failed)
+		{
+			printf "\nbench: %d regression(s) against baseline\n", failed
+		}
+		if (failed || unchecked)
+		{
+			exit 1
+		}
+		printf "\nbench: no regressions\n"
+	}
+' "$baseline" "$results"
@@ -22,12 +22,33 @@ typedef struct circular_buf_t circular_buf_t;
 //
 typedef circular_buf_t * cbuf_handle_t;
 
+//What circular_buf_put() does when the buffer is full. Every case counts as an overrun.
+//
+typedef enum
+{
+    CBUF_OVERWRITE,   // store the new element, the oldest one is lost (default)
+    CBUF_DROP_NEWEST, // discard the new element, put reports success
+    CBUF_REJECT       // discard the new element, put reports failure (-1)
+} cbuf_policy_t;
+
+//Counters kept by the buffer. Not updated atomically, a reader that can be
+//interrupted by a writer must disable interrupts around circular_buf_stats().
+//
+typedef struct
+{
+    uint16_t overruns;   // puts made while full, wraps around
+    size_t   high_water; // most elements ever stored at once
+} cbuf_stats_t;
+
 // Public API functions provided by the circular buffer library
 //
 cbuf_handle_t circular_buf_init (TYPE * buffer, size_t size);
 BOOL circular_buf_empty (cbuf_handle_t cbuf);
 BOOL circular_buf_full (cbuf_handle_t cbuf);
-void circular_buf_put (cbuf_handle_t cbuf, TYPE data);
+int circular_buf_put (cbuf_handle_t cbuf, TYPE data);
+void circular_buf_set_policy (cbuf_handle_t cbuf, cbuf_policy_t policy);
+void circular_buf_stats (cbuf_handle_t cbuf, cbuf_stats_t * p_stats);
+void circular_buf_reset_stats (cbuf_handle_t cbuf);
 size_t circular_buf_capacity (cbuf_handle_t cbuf);
 void circular_buf_reset (cbuf_handle_t cbuf);
 int circular_buf_get (cbuf_handle_t cbuf, TYPE * p_value);
@@ -0,0 +1,22 @@
+/**
+ * @file atmega168_gpio.h
+ *
+ * @brief 
+ * Driver code for the atmega168 general purpose I/O used outside of the other
+ * peripherals. Currently the ESP8266 wake line on PD2, which is wired to the
+ * ESP8266 RST pin, and the RS-485 transceiver driver enable on PD4 (bus mode).
+ */
+
+#ifndef _ATMEGA168_GPIO_H_
+#define _ATMEGA168_GPIO_H_
+
+void create_wake_line(void);
+void assert_wake_line(void);
+void release_wake_line(void);
+void create_bus_enable(void);
+void bus_transmit_enable(void);
+void bus_transmit_disable(void);
+
+#endif /*_ATMEGA168_GPIO_H_*/
+
+/*** end of file ***/
@@ -4,16 +4,25 @@
  * @brief 
  * Driver code for atmega168 8-bit timer.
  * Uses output compare match interrupt to count in 1ms increments.
+ * Also provides a free-running 16-bit counter (Timer1) used for timestamps.
  */
 
 #ifndef _ATMEGA168_TIMER_H_
 #define _ATMEGA168_TIMER_H_
 
 #include <stdio.h>
+#include <stdint.h>
 
 void create_timer(void);
 void on(void);
 void off(void);
+void disable_timer_interrupt(void);
+void enable_timer_interrupt(void);
+uint8_t read_timer(void);
+uint8_t compare_pending(void);
+void idle(void);
+void create_counter(void);
+uint16_t read_counter(void);
 extern void TimerISR(void);
 
 #endif
@@ -18,6 +18,11 @@ void send(uint8_t data);
 BOOL is_data_available(void);
 void flush(void);
 uint8_t receive(void);
+void enable_tx_interrupt(void);
+void disable_tx_interrupt(void);
+void enable_tx_complete_interrupt(void);
 extern void uart_rx_complete_ISR(void);
+extern void uart_tx_ready_ISR(void);
+extern void uart_tx_complete_ISR(void);
 
 #endif /*_UART_ATMEGA168_H_*/
\ No newline at end of file
@@ -0,0 +1,70 @@
+/**
+ * @file bus.h
+ *
+ * @brief 
+ * Multi-drop RS-485 bus mode. Enabled with BUS_MODE set to 1 ("make BUS=1
+ * NODE_ID=<1-247>"). Many door nodes share one half-duplex bus with a single
+ * ESP8266 coordinator, which polls the nodes one at a time. A node only ever
+ * transmits in answer to a poll addressed to it, so replies cannot collide.
+ *
+ * In bus mode every frame (see frame.h) carries the address of the node it is
+ * for or from right after FRAME_SOF:
+ *
+ *     FRAME_SOF | address | type | length | payload | checksum
+ *
+ * and the checksum includes the address. Frames addressed to other nodes are
+ * parsed and ignored. BUS_BROADCAST reaches every node, but is never answered.
+ *
+ *     coordinator                               node
+ *     FRAME_CMD_POLL to node      ------------>  reply scheduled by the receive ISR
+ *     releases its driver                        BUS_TURNAROUND_MS later, from the
+ *                                 <------------  timer ISR: FRAME_STATUS:
+ *                                                status | sequence | adc
+ *
+ * status is the last reported door state ('o', 'c', or '?' before the first one)
+ * and sequence counts state changes, so the coordinator notices an open and close
+ * that both happened between two polls.
+ *
+ * The node drives the transceiver's driver enable (see atmega168_gpio.h) for the
+ * duration of its reply only. It waits BUS_TURNAROUND_MS after the poll before
+ * enabling it: the coordinator only releases the bus once its last byte has left
+ * the shift register, up to one character after its UART reports the data sent,
+ * and both drivers must never be on at once.
+ *
+ * The plain status messages, hints, telemetry and command acknowledgements all
+ * transmit unasked and are not sent in bus mode. Logging and tracing would do the
+ * same, building with LOG=1 or TRACE=1 and BUS=1 is an error.
+ */
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdint.h>
+#include "fsm.h"
+
+#ifndef BUS_MODE
+#define BUS_MODE 0
+#endif
+
+#ifndef NODE_ID
+#define NODE_ID 1
+#endif
+
+#if BUS_MODE && ((defined(LOG_ENABLE) && LOG_ENABLE) || (defined(TRACE_ENABLE) && TRACE_ENABLE))
+#error "LOG=1 or TRACE=1 transmit unasked and cannot be combined with BUS=1"
+#endif
+
+#define BUS_BROADCAST     0x00
+#define BUS_STATUS_SIZE   3
+#define BUS_TURNAROUND_MS 2 //poll to reply, 2-3 ms: 2+ characters at 9600 baud
+
+void bus_init(void);
+void bus_post(door status, uint8_t curr_adc);
+void bus_poll_ISR(void);
+void bus_tick_ISR(void);
+void bus_tx_complete_ISR(void);
+uint16_t bus_polls(void);
+
+#endif // BUS_H
+
+/*** end of file ***/
@@ -0,0 +1,26 @@
+/**
+ * @file control.h
+ *
+ * @brief 
+ * Inbound control channel. Applies the commands the ESP8266 sends as frames
+ * (see frame.h) and answers every command except FRAME_CMD_ACK with a FRAME_ACK
+ * frame carrying the command type and a frame_status. In bus mode (see bus.h)
+ * commands are applied but not answered.
+ *
+ *     FRAME_CMD_ACK         counted, see control_acks()
+ *     FRAME_CMD_SET_PARAM   PARAM_TELEMETRY_PERIOD_S, PARAM_OPEN_REPEAT_MS
+ *     FRAME_CMD_SAMPLE_RATE sampler_set_bounds()
+ *     FRAME_CMD_TELEMETRY   telemetry_request()
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdint.h>
+
+void control_poll(void);
+uint16_t control_acks(void);
+
+#endif // CONTROL_H
+
+/*** end of file ***/
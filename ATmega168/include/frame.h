@@ -0,0 +1,90 @@
+/**
+ * @file frame.h
+ *
+ * @brief 
+ * Typed binary frames exchanged with the ESP8266:
+ *
+ *     FRAME_SOF | type | length | payload (length bytes) | checksum
+ *
+ * where checksum is the 8-bit sum of type, length and the payload bytes, and all
+ * multi-byte payload values are little endian. FRAME_SOF is never a valid status
+ * message, so the ESP8266 can tell frames and status bytes apart.
+ *
+ * Frames are queued with uart_queue() and dropped, never blocked on, when the
+ * UART transmit buffer is full.
+ *
+ * Frames from the ESP8266 (commands) are parsed byte by byte in the UART receive
+ * interrupt by frame_receive_ISR(). Only complete frames with a valid checksum
+ * reach the FRAME_QUEUE_SIZE entry queue read by frame_receive(); bytes outside a
+ * frame are left in the UART receive buffer as before. A frame longer than
+ * FRAME_CMD_PAYLOAD is skipped up to its checksum, so its bytes are not taken for
+ * status messages. A frame that stops arriving part way is discarded by
+ * frame_rx_tick().
+ *
+ * In bus mode (see bus.h) an address byte follows FRAME_SOF, frames for other
+ * nodes are ignored and polls are answered from the interrupt.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+
+#define FRAME_SOF         0xF7 //start of frame, cannot be confused with a status message
+#define FRAME_MAX_PAYLOAD 16
+#define FRAME_CMD_PAYLOAD 4  //largest command payload accepted
+#define FRAME_QUEUE_SIZE  4  //complete commands waiting for the main loop, power of two
+
+enum frame_type
+{
+	//MCU -> ESP8266
+	FRAME_TELEMETRY       = 0x01, //see telemetry.h
+	FRAME_ACK             = 0x02, //command type | enum frame_status
+	FRAME_STATUS          = 0x03, //bus mode poll reply, see bus.h
+	FRAME_LINK_STATS      = 0x04, //deep sleep mode delivery counters, see link.h
+
+	//ESP8266 -> MCU
+	FRAME_CMD_ACK         = 0x10, //type of the frame acknowledged
+	FRAME_CMD_SET_PARAM   = 0x11, //enum frame_param | value (2 bytes)
+	FRAME_CMD_SAMPLE_RATE = 0x12, //fast period ms (2 bytes) | slow period ms (2 bytes)
+	FRAME_CMD_TELEMETRY   = 0x13, //no payload, send a telemetry record now
+	FRAME_CMD_POLL        = 0x14, //bus mode, no payload, answered with FRAME_STATUS
+};
+
+enum frame_param
+{
+	PARAM_TELEMETRY_PERIOD_S = 0x01, //0 stops telemetry
+	PARAM_OPEN_REPEAT_MS     = 0x02, //see fsm_set_repeat()
+};
+
+enum frame_status
+{
+	FRAME_OK          = 0x00,
+	FRAME_BAD_COMMAND = 0x01, //unknown type or parameter
+	FRAME_BAD_VALUE   = 0x02, //wrong payload length or value out of range
+};
+
+struct frame_msg
+{
+	uint8_t type;
+	uint8_t length;
+	uint8_t payload[FRAME_CMD_PAYLOAD];
+};
+
+struct frame_rx_stats
+{
+	uint16_t frames;  //complete frames queued
+	uint16_t errors;  //bad length or checksum, or timed out
+	uint16_t dropped; //valid frames lost because the queue was full
+};
+
+int frame_send(uint8_t type, const uint8_t * payload, uint8_t length);
+uint16_t frame_dropped(void);
+int frame_receive_ISR(uint8_t byte);
+void frame_rx_tick(void);
+int frame_receive(struct frame_msg * msg);
+void frame_get_rx_stats(struct frame_rx_stats * stats);
+
+#endif // FRAME_H
+
+/*** end of file ***/
@@ -0,0 +1,28 @@
+/**
+ * @file fsm.h
+ *
+ * @brief 
+ * Door monitoring finite-state machine. Kept apart from main.c so that a single
+ * FSM step can be driven on its own (e.g. by the benchmark harness in bench/).
+ *
+ * See docs/door-status-notifier-state-machine.png for the state diagram.
+ */
+
+#ifndef FSM_H
+#define FSM_H
+
+#include <stdint.h>
+
+#define THRESHOLD 100  //adc threshold for determining if door is open or closed
+#define DELAY     2000 //ms, default delay before another "OPEN" message is sent
+
+enum fsm_states {INIT, OPEN00, OPEN01, CLOSED00, CLOSED01};
+typedef enum door_status {IS_OPEN, IS_CLOSED, UNCHANGED} door;
+
+void fsm_init(void);
+void fsm_set_repeat(uint16_t ms);
+door fsm_tick(uint8_t curr_adc, uint16_t elapsed_ms);
+
+#endif // FSM_H
+
+/*** end of file ***/
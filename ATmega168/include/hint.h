@@ -0,0 +1,28 @@
+/**
+ * @file hint.h
+ *
+ * @brief 
+ * "Approaching threshold" hint for the ESP8266. When the adc reading enters the band
+ * THRESHOLD +/- HINT_BAND the MCU sends HINT_MESSAGE so the ESP8266 can open its
+ * network connection before the door actually changes state.
+ *
+ * A hint is sent when the reading enters the band, and at most once every
+ * HINT_HOLDOFF_MS while it stays there. Hints are low priority: they are queued
+ * without blocking and dropped if the UART transmit buffer is full.
+ */
+
+#ifndef HINT_H
+#define HINT_H
+
+#include <stdint.h>
+
+#define HINT_MESSAGE    'h'
+#define HINT_BAND       15    //adc counts either side of THRESHOLD
+#define HINT_HOLDOFF_MS 15000 //about how long the ESP8266 keeps a warm connection
+
+void hint_init(void);
+int hint_update(uint8_t curr_adc, uint16_t elapsed_ms);
+
+#endif // HINT_H
+
+/*** end of file ***/
@@ -0,0 +1,64 @@
+/**
+ * @file link.h
+ *
+ * @brief 
+ * Event delivery to an ESP8266 that spends its time in deep sleep. Enabled with
+ * ESP_DEEP_SLEEP set to 1 ("make ESP_DEEP_SLEEP=1"), otherwise status messages are
+ * sent straight over the UART as before.
+ *
+ * Events are buffered and delivered with the following handshake:
+ *
+ *     ATmega168                          ESP8266
+ *     pulse wake line (ESP RST) ------>  boots
+ *                               <------  LINK_READY
+ *     event ('o' or 'c')        ------>  connects, posts
+ *                               <------  LINK_ACK
+ *     next event, if any        ------>  ...
+ *                                        deep sleep after LINK_LINGER_MS idle
+ *
+ * If LINK_READY or LINK_ACK does not arrive in time the ESP8266 is woken again, up
+ * to LINK_RETRIES times before the event is dropped. The time from asserting the
+ * wake line to receiving LINK_ACK is measured for every delivered event.
+ *
+ * Once the queue is empty the counters below are sent as a FRAME_LINK_STATS frame
+ * (see frame.h) while the ESP8266 lingers, each field 2 bytes little endian in
+ * struct order. The ESP8266 keeps them with its own wake statistics.
+ */
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+
+#ifndef ESP_DEEP_SLEEP
+#define ESP_DEEP_SLEEP 0
+#endif
+
+#define LINK_READY 'R'
+#define LINK_ACK   'A'
+
+#define LINK_QUEUE_SIZE       8     //events buffered while the ESP8266 wakes up
+#define LINK_READY_TIMEOUT_MS 3000  //boot until LINK_READY
+#define LINK_ACK_TIMEOUT_MS   20000 //event until LINK_ACK, includes WiFi and HTTPS
+#define LINK_LINGER_MS        200   //ESP8266 waits this long for another event
+#define LINK_RETRIES          3
+
+struct link_stats
+{
+	uint16_t delivered;
+	uint16_t dropped;
+	uint16_t retries;
+	uint16_t last_latency_ms; //wake line asserted until LINK_ACK
+	uint16_t max_latency_ms;
+};
+
+void link_init(void);
+int link_post(char event);
+void link_receive(char data);
+void link_tick(void);
+int link_busy(void);
+void link_get_stats(struct link_stats * stats);
+
+#endif // LINK_H
+
+/*** end of file ***/
@@ -0,0 +1,64 @@
+/**
+ * @file log.h
+ *
+ * @brief 
+ * Deferred binary logging for the ATmega168. Format strings are stored in flash
+ * and never transmitted. A log call only queues a small frame on the UART:
+ *
+ *     LOG_SOF | id (2 bytes) | arguments (2 bytes each)
+ *
+ * where id is the flash address of the format string and all multi-byte values
+ * are little endian. tools/log_decode.py looks the format strings up in the ELF
+ * file and prints the readable messages.
+ *
+ * Only 16-bit conversions are supported (%d, %i, %u, %x, %X, %c). Up to three
+ * arguments can be passed, using LOG0() to LOG3(). Frames are dropped, never
+ * blocked on, when the UART transmit buffer is full.
+ *
+ * Logging is compiled out unless LOG_ENABLE is set to 1 ("make LOG=1"). The log
+ * frames share the UART with the door status messages, so only enable it when
+ * the UART is connected to a host running the decoder.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+#ifndef LOG_ENABLE
+#define LOG_ENABLE 0
+#endif
+
+#define LOG_SOF 0xF5 //start of frame, cannot be confused with a status message
+
+#if LOG_ENABLE
+
+#include <avr/pgmspace.h>
+
+//the "log_fmt_" prefix is what the decoder uses to find the format strings
+#define LOG_WRITE(fmt, argc, a0, a1, a2)                                     \
+	do                                                                       \
+	{                                                                        \
+		static const char log_fmt_[] __attribute__((used))                   \
+			__attribute__((section(".progmem.logfmt"))) = fmt;               \
+		log_write((uint16_t)(uintptr_t)log_fmt_, (argc), (uint16_t)(a0),     \
+		          (uint16_t)(a1), (uint16_t)(a2));                           \
+	} while (0)
+
+#else
+
+#define LOG_WRITE(fmt, argc, a0, a1, a2) do {} while (0)
+
+#endif // LOG_ENABLE
+
+#define LOG0(fmt)             LOG_WRITE(fmt, 0, 0, 0, 0)
+#define LOG1(fmt, a0)         LOG_WRITE(fmt, 1, a0, 0, 0)
+#define LOG2(fmt, a0, a1)     LOG_WRITE(fmt, 2, a0, a1, 0)
+#define LOG3(fmt, a0, a1, a2) LOG_WRITE(fmt, 3, a0, a1, a2)
+
+void log_write(uint16_t id, uint8_t argc, uint16_t a0, uint16_t a1, uint16_t a2);
+uint16_t log_dropped(void);
+
+#endif // LOG_H
+
+/*** end of file ***/
@@ -0,0 +1,110 @@
+/**
+ * @file ring.h
+ *
+ * @brief
+ * Generic ring buffer generator. RING_DEFINE(name, type, size) emits a ring type
+ * name_t holding up to size elements of type, plus static inline functions that
+ * operate on it:
+ *
+ *     void    name_reset (name_t * r);
+ *     uint8_t name_size  (const name_t * r);
+ *     int     name_empty (const name_t * r);
+ *     int     name_full  (const name_t * r);
+ *     int     name_put   (name_t * r, type value);     //-1 if full, value dropped
+ *     void    name_push  (name_t * r, type value);     //overwrites oldest if full
+ *     int     name_get   (name_t * r, type * p_value); //-1 if empty
+ *     type *  name_peek  (name_t * r);                 //NULL if empty
+ *
+ * size must be a power of two no larger than 128. The head and tail indices are
+ * free-running 8-bit counters, so wrapping is a single mask and every index update
+ * is one atomic byte store. With one producer and one consumer (e.g. an ISR and the
+ * main loop) name_put() and name_get() need no locking. name_push() and
+ * name_reset() touch both indices and must not race with the consumer.
+ *
+ * Example:
+ *     RING_DEFINE(sample_ring, uint16_t, 16)
+ *     static sample_ring_t samples;
+ *     sample_ring_put(&samples, 512);
+ *
+ * Unlike CircularBuffer.h, rings are plain structs with no malloc, and any number of
+ * differently typed rings can coexist in one binary.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RING_DEFINE(name, type, size)                                          \
+	typedef char name##_size_check[(((size) & ((size) - 1)) == 0 &&            \
+	                               (size) <= 128) ? 1 : -1];                  \
+                                                                               \
+	typedef struct                                                             \
+	{                                                                          \
+		type buffer[size];                                                     \
+		volatile uint8_t head; /* next element to read  */                    \
+		volatile uint8_t tail; /* next element to write */                    \
+	} name##_t;                                                                \
+                                                                               \
+	static inline void name##_reset(name##_t * r)                              \
+	{                                                                          \
+		r->head = 0;                                                           \
+		r->tail = 0;                                                           \
+	}                                                                          \
+                                                                               \
+	static inline uint8_t name##_size(const name##_t * r)                      \
+	{                                                                          \
+		return (uint8_t)(r->tail - r->head);                                   \
+	}                                                                          \
+                                                                               \
+	static inline int name##_empty(const name##_t * r)                         \
+	{                                                                          \
+		return r->tail == r->head;                                             \
+	}                                                                          \
+                                                                               \
+	static inline int name##_full(const name##_t * r)                          \
+	{                                                                          \
+		return name##_size(r) == (size);                                       \
+	}                                                                          \
+                                                                               \
+	static inline int name##_put(name##_t * r, type value)                     \
+	{                                                                          \
+		if (name##_full(r))                                                    \
+		{                                                                      \
+			return -1;                                                         \
+		}                                                                      \
+		r->buffer[r->tail & ((size) - 1)] = value;                             \
+		r->tail = r->tail + 1;                                                 \
+		return 0;                                                              \
+	}                                                                          \
+                                                                               \
+	static inline void name##_push(name##_t * r, type value)                   \
+	{                                                                          \
+		if (name##_full(r))                                                    \
+		{                                                                      \
+			r->head = r->head + 1;                                             \
+		}                                                                      \
+		r->buffer[r->tail & ((size) - 1)] = value;                             \
+		r->tail = r->tail + 1;                                                 \
+	}                                                                          \
+                                                                               \
+	static inline int name##_get(name##_t * r, type * p_value)                 \
+	{                                                                          \
+		if (name##_empty(r))                                                   \
+		{                                                                      \
+			return -1;                                                         \
+		}                                                                      \
+		*p_value = r->buffer[r->head & ((size) - 1)];                          \
+		r->head = r->head + 1;                                                 \
+		return 0;                                                              \
+	}                                                                          \
+                                                                               \
+	static inline type * name##_peek(name##_t * r)                             \
+	{                                                                          \
+		return name##_empty(r) ? NULL : &r->buffer[r->head & ((size) - 1)];    \
+	}
+
+#endif // RING_H
+
+/*** end of file ***/
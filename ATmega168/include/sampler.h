@@ -0,0 +1,46 @@
+/**
+ * @file sampler.h
+ *
+ * @brief 
+ * Activity-adaptive sampling rate controller. Decides how long to wait before the
+ * next adc sample: the fast period right after the door changes state or while
+ * readings are moving or close to THRESHOLD, decaying back to the slow period
+ * once the door has been quiet for SAMPLER_HOLD_MS.
+ *
+ * Also keeps track of how long the MCU was awake versus asleep so the effective
+ * duty cycle can be reported.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include "fsm.h"
+
+#define SAMPLER_FAST_MS   50    //default period while active (20Hz)
+#define SAMPLER_SLOW_MS   1000  //default period while idle (1Hz)
+#define SAMPLER_MIN_MS    10    //bounds accepted by sampler_set_bounds()
+#define SAMPLER_MAX_MS    60000
+#define SAMPLER_HOLD_MS   5000  //stay at the fast period this long after activity
+#define SAMPLER_BAND      20    //readings within THRESHOLD +/- band count as activity
+#define SAMPLER_DELTA     8     //so do changes larger than this between samples
+
+struct sampler_stats
+{
+	uint32_t samples;    //number of samples taken
+	uint32_t elapsed_ms; //total time covered by those samples
+	uint32_t fast_ms;    //part of elapsed_ms spent at the fast period
+	uint32_t awake_us;   //part of elapsed_ms the MCU was awake
+};
+
+void sampler_init(void);
+void sampler_set_bounds(uint16_t fast_ms, uint16_t slow_ms);
+uint16_t sampler_update(uint8_t curr_adc, door status, uint32_t awake_us);
+void sampler_poke(void);
+uint16_t sampler_period(void);
+void sampler_get_stats(struct sampler_stats * stats);
+uint16_t sampler_duty_permille(void);
+
+#endif // SAMPLER_H
+
+/*** end of file ***/
@@ -0,0 +1,43 @@
+/**
+ * @file telemetry.h
+ *
+ * @brief 
+ * Periodic health telemetry for the ESP8266. Every TELEMETRY_PERIOD_MS the MCU
+ * sends one FRAME_TELEMETRY frame (see frame.h) summarizing the samples taken
+ * since the previous one. Payload, little endian:
+ *
+ *     offset  size  field
+ *     0       1     TELEMETRY_VERSION
+ *     1       1     lowest adc reading
+ *     2       1     highest adc reading
+ *     3       1     mean adc reading
+ *     4       2     number of samples
+ *     6       1     door state changes (saturates at 255)
+ *     7       1     UART receive overruns (saturates at 255)
+ *     8       2     sampling duty cycle, permille (see sampler.h)
+ *     10      2     uptime, minutes
+ *     12      1     UART receive buffer high-water mark since boot, bytes
+ *
+ * That is 17 bytes on the serial link per period. The period can be changed, and
+ * a record requested early, by commands from the ESP8266 (see control.h). The
+ * ESP8266 aggregates the records over a longer window before reporting them.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "fsm.h"
+
+#define TELEMETRY_VERSION   2
+#define TELEMETRY_SIZE      13
+#define TELEMETRY_PERIOD_MS 60000UL //default, see telemetry_set_period()
+
+void telemetry_init(void);
+void telemetry_set_period(uint32_t period);
+void telemetry_request(void);
+void telemetry_sample(uint8_t curr_adc, door status, uint16_t elapsed_ms);
+
+#endif // TELEMETRY_H
+
+/*** end of file ***/
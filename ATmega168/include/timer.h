@@ -15,11 +15,14 @@
 #include <stdint.h>
 #include "atmega168_timer.h"
 
-volatile uint8_t TimerFlag;
+extern volatile uint8_t TimerFlag;
 
 void timer_init(uint16_t period);
 void timer_on(void);
 void timer_off(void);
+void timer_set_period(uint16_t period);
+void timer_wait(void);
+uint32_t timer_micros(void);
 
 #endif // TIMER_H
 
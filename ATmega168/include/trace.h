@@ -0,0 +1,64 @@
+/**
+ * @file trace.h
+ *
+ * @brief 
+ * Optional ISR and main loop trace for the ATmega168. Each TRACE() call stores an
+ * event id and a timestamp taken from Timer1, which runs freely at 1MHz (1us per
+ * tick), in a small ring buffer that keeps the most recent TRACE_DEPTH events.
+ *
+ * Sending TRACE_REQUEST to the MCU makes the main loop dump the ring over the UART:
+ *
+ *     TRACE_SOF | count | count x (event, timestamp low, timestamp high) | checksum
+ *
+ * where checksum is the 8-bit sum of every byte after TRACE_SOF. Recording is paused
+ * during the dump and the ring is emptied afterwards. tools/trace_view.py turns the
+ * dump into a timeline and reports ISR jitter and nesting.
+ *
+ * Tracing is compiled out unless TRACE_ENABLE is set to 1 ("make TRACE=1").
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 0
+#endif
+
+#define TRACE_DEPTH   64   //must be a power of two
+#define TRACE_SOF     0xF6 //start of dump, cannot be confused with a status message
+#define TRACE_REQUEST 'T'  //byte that requests a dump
+
+//event ids, keep in sync with tools/trace_view.py
+enum trace_event
+{
+	TRACE_TIMER_ENTER = 1,
+	TRACE_TIMER_EXIT,
+	TRACE_RX_ENTER,
+	TRACE_RX_EXIT,
+	TRACE_UDRE_ENTER,
+	TRACE_UDRE_EXIT,
+	TRACE_ADC_BEGIN,
+	TRACE_ADC_END,
+	TRACE_FSM_BEGIN,
+	TRACE_FSM_END,
+	TRACE_SEND_BEGIN,
+	TRACE_SEND_END,
+	TRACE_IDLE_BEGIN,
+	TRACE_IDLE_END
+};
+
+#if TRACE_ENABLE
+#define TRACE(event) trace_record(event)
+#else
+#define TRACE(event) do {} while (0)
+#endif
+
+void trace_init(void);
+void trace_record(uint8_t event);
+void trace_dump(void);
+
+#endif // TRACE_H
+
+/*** end of file ***/
@@ -15,7 +15,12 @@
 #include <stdint.h>
 #include "CircularBuffer.h"
 
-#define CBUF_SIZE 64
+#define CBUF_SIZE    64
+#define TX_CBUF_SIZE 64
+
+//what the receive interrupt does with a byte that arrives while the buffer is full,
+//see cbuf_policy_t. Overruns are counted either way, see uart_rx_stats().
+#define RX_OVERFLOW_POLICY CBUF_OVERWRITE
 
 enum {SUCCESS = 0, FAIL = -1, CHAR_NOT_FOUND = -2, UNKNOWN = -3};
 enum {MCU, KEYBOARD};
@@ -25,8 +30,13 @@ void uart_terminate(void);
 BOOL uart_send_ready(void);
 void uart_send(char data);
 int uart_send_string(char * string, size_t sz);
+int uart_queue(const char * data, size_t sz);
 void uart_rx_complete_ISR(void);
+void uart_tx_ready_ISR(void);
 size_t uart_available(void);
+uint16_t uart_rx_overruns(void);
+void uart_rx_stats(cbuf_stats_t * stats);
+void uart_tx_stats(cbuf_stats_t * stats);
 int uart_read(char * data);
 int uart_read_string(char * data, int inputMethod);
 void uart_flush(void);
@@ -18,6 +18,8 @@ struct circular_buf_t
     size_t    tail;
     size_t    max; // This variable represents the maximum size of the buffer.
     BOOL      b_is_buffer_full;
+    cbuf_policy_t policy;
+    cbuf_stats_t  stats;
 };
 
 enum {TRUE = 1, FALSE = 0};
@@ -70,7 +72,9 @@ cbuf_handle_t circular_buf_init (TYPE * p_buffer, size_t size)
     cbuf_handle_t cbuf = malloc(sizeof(circular_buf_t));
     cbuf->p_buffer = p_buffer;
     cbuf->max = size;
+    cbuf->policy = CBUF_OVERWRITE;
     circular_buf_reset(cbuf);
+    circular_buf_reset_stats(cbuf);
 
     return cbuf;
 }
@@ -106,12 +110,76 @@ BOOL circular_buf_full (cbuf_handle_t cbuf)
  * @brief Place a single data element into the underlying buffer.
  * @param[in] cbuf Handle for circular buffer.
  * @param[in] data Data element to be stored in circular buffer.
+ * @return -1 if the buffer was full and the policy is CBUF_REJECT, 0 otherwise.
+ *
+ * @par
+ * When the buffer is full the overrun counter is incremented and the element is
+ * handled according to the policy set with circular_buf_set_policy().
  */
-void circular_buf_put (cbuf_handle_t cbuf, TYPE data)
+int circular_buf_put (cbuf_handle_t cbuf, TYPE data)
 {
+    if (cbuf->b_is_buffer_full)
+    {
+        cbuf->stats.overruns++;
+
+        if (cbuf->policy == CBUF_REJECT)
+        {
+            return -1;
+        }
+        if (cbuf->policy == CBUF_DROP_NEWEST)
+        {
+            return 0;
+        }
+    }
+
     cbuf->p_buffer[cbuf->tail] = data;
 
     advance_tail(cbuf);
+
+    size_t size = circular_buf_size(cbuf);
+    if (size > cbuf->stats.high_water)
+    {
+        cbuf->stats.high_water = size;
+    }
+
+    return 0;
+}
+
+/*!
+ * @brief Choose what happens to elements put into a full buffer.
+ * @param[in] cbuf   Handle for circular buffer.
+ * @param[in] policy One of cbuf_policy_t, CBUF_OVERWRITE after initialization.
+ */
+void circular_buf_set_policy (cbuf_handle_t cbuf, cbuf_policy_t policy)
+{
+    cbuf->policy = policy;
+}
+
+/*!
+ * @brief Copy the overrun and high-water counters.
+ * @param[in]  cbuf    Handle for circular buffer.
+ * @param[out] p_stats Where the counters are copied to.
+ *
+ * @par
+ * The copy is not atomic. If an interrupt handler puts into this buffer, call
+ * this function with interrupts disabled.
+ */
+void circular_buf_stats (cbuf_handle_t cbuf, cbuf_stats_t * p_stats)
+{
+    *p_stats = cbuf->stats;
+}
+
+/*!
+ * @brief Clear the overrun and high-water counters.
+ * @param[in] cbuf Handle for circular buffer.
+ *
+ * @par
+ * circular_buf_reset() leaves the counters alone, so they survive flushes.
+ */
+void circular_buf_reset_stats (cbuf_handle_t cbuf)
+{
+    cbuf->stats.overruns = 0;
+    cbuf->stats.high_water = 0;
 }
 
 /*!
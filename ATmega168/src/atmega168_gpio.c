@@ -0,0 +1,58 @@
+/**
+ * @file atmega168_gpio.c
+ *
+ * @brief 
+ * Driver code for the atmega168 general purpose I/O used outside of the other
+ * peripherals. Currently the ESP8266 wake line on PD2, which is wired to the
+ * ESP8266 RST pin, and the RS-485 transceiver driver enable on PD4 (bus mode).
+ *
+ * The wake line is driven open-drain: it is either pulled low or left floating,
+ * the ESP8266's own pull-up keeps RST high. The ATmega168 therefore never drives
+ * its supply voltage into the 3.3V ESP8266 pin.
+ *
+ * The transceiver's DE and /RE pins are tied together on PD4: high transmits,
+ * low receives. The receiver is off while transmitting, so a node does not
+ * hear its own replies.
+ */
+
+#include <avr/io.h>
+
+#include "atmega168_gpio.h"
+
+void create_wake_line(void)
+{
+	//output value is always 0, only the direction is switched
+	PORTD &= ~(1 << PD2);
+	release_wake_line();
+}
+
+void assert_wake_line(void)
+{
+	//output, pulls RST low
+	DDRD |= (1 << PD2);
+}
+
+void release_wake_line(void)
+{
+	//input without pull-up, high impedance
+	DDRD &= ~(1 << PD2);
+}
+
+void create_bus_enable(void)
+{
+	//output, start out receiving
+	bus_transmit_disable();
+	DDRD |= (1 << PD4);
+}
+
+void bus_transmit_enable(void)
+{
+	PORTD |= (1 << PD4);
+}
+
+void bus_transmit_disable(void)
+{
+	PORTD &= ~(1 << PD4);
+}
+
+/*** end of file ***/
@@ -8,8 +8,10 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 #include "atmega168_timer.h"
+#include "trace.h"
 
 void create_timer(void)
 {
@@ -51,9 +53,58 @@ void off(void)
 	TIMSK0 &= ~(1 << OCIE0A);
 }
 
+void disable_timer_interrupt(void)
+{
+	TIMSK0 &= ~(1 << OCIE0A);
+}
+
+void enable_timer_interrupt(void)
+{
+	TIMSK0 |= (1 << OCIE0A);
+}
+
+uint8_t read_timer(void)
+{
+	return TCNT0;
+}
+
+uint8_t compare_pending(void)
+{
+	//set when a compare match occurred but its interrupt has not run yet
+	return (TIFR0 & (1 << OCF0A)) != 0;
+}
+
+void idle(void)
+{
+	//Idle mode stops the CPU but keeps timers and the USART running, so the
+	//next interrupt (at most 1ms away) wakes the MCU up again
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_mode();
+}
+
+void create_counter(void)
+{
+	//Normal mode, counter runs freely from 0 to 0xFFFF and wraps around
+	TCCR1A = 0;
+	TCNT1  = 0;
+
+	//Clock select: internal 8MHz clock with prescaler of 8
+	// 8MHz / 8 = 1,000,000 ticks/sec => one tick every 1us, wraps every 65.5ms
+	TCCR1B = (1 << CS11);
+}
+
+uint16_t read_counter(void)
+{
+	//16-bit registers are read through a shared temporary register, interrupts
+	//must be disabled by the caller if an ISR could read Timer1 at the same time
+	return TCNT1;
+}
+
 ISR(TIMER0_COMPA_vect)
 {
+	TRACE(TRACE_TIMER_ENTER);
 	TimerISR();
+	TRACE(TRACE_TIMER_EXIT);
 }
 
 /*** end of file ***/
\ No newline at end of file
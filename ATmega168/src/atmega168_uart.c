@@ -14,6 +14,7 @@
 #include <avr/interrupt.h>
 
 #include "atmega168_uart.h"
+#include "trace.h"
 
 
 
@@ -107,10 +108,47 @@ uint8_t receive(void)
 	return data;
 }
 
+void enable_tx_interrupt(void)
+{
+	//data register empty interrupt fires as long as UDR0 can accept a byte
+	//
+	UCSR0B |= (1 << UDRIE0);
+}
+
+void disable_tx_interrupt(void)
+{
+	UCSR0B &= ~(1 << UDRIE0);
+}
+
+void enable_tx_complete_interrupt(void)
+{
+	//fires once the last queued byte has left the shift register
+	//
+	UCSR0B |= (1 << TXCIE0);
+}
+
 ISR(USART_RX_vect)
 {
 	//calls function that implements required functionality
 	//designed this way to make the ISR testable with Unity
 	//
+	TRACE(TRACE_RX_ENTER);
 	uart_rx_complete_ISR();
+	TRACE(TRACE_RX_EXIT);
+}
+
+ISR(USART_UDRE_vect)
+{
+	//same approach as the receive interrupt, see above
+	//
+	TRACE(TRACE_UDRE_ENTER);
+	uart_tx_ready_ISR();
+	TRACE(TRACE_UDRE_EXIT);
+}
+
+ISR(USART_TX_vect)
+{
+	//same approach as the receive interrupt, see above
+	//
+	uart_tx_complete_ISR();
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+/**
+ * @file bus.c
+ *
+ * @brief 
+ * Multi-drop RS-485 bus mode. See bus.h for the protocol.
+ */
+
+#include <util/atomic.h>
+
+#include "bus.h"
+#include "atmega168_gpio.h"
+#include "atmega168_uart.h"
+#include "frame.h"
+#include "uart.h"
+
+//reply to the next poll, built by the main loop and sent from the receive ISR
+static uint8_t reply[BUS_STATUS_SIZE];
+static volatile uint16_t polls;
+//timer ticks until the reply is sent, 0 when none is due
+static volatile uint8_t reply_ticks;
+
+/*!
+ * @brief Set up the transceiver and the reply. Call after uart_init().
+ */
+void bus_init(void)
+{
+	create_bus_enable();
+	enable_tx_complete_interrupt();
+
+	reply[0] = '?';
+	reply[1] = 0;
+	reply[2] = 0;
+	reply_ticks = 0;
+}
+
+/*!
+ * @brief Update the reply with the latest sample.
+ * @param[in] status   Result of fsm_tick() for this sample.
+ * @param[in] curr_adc Latest adc reading.
+ *
+ * @par
+ * Repeats of the current state (the FSM repeats "OPEN") do not count as changes.
+ */
+void bus_post(door status, uint8_t curr_adc)
+{
+	char code = (status == IS_OPEN) ? 'o' : (status == IS_CLOSED) ? 'c' : 0;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (code && code != (char)reply[0])
+		{
+			reply[0]  = (uint8_t)code;
+			reply[1] += 1;
+		}
+		reply[2] = curr_adc;
+	}
+}
+
+/*!
+ * @brief Schedule the answer to a poll. Called by the frame parser in the receive ISR.
+ *
+ * @par
+ * The reply goes out from bus_tick_ISR() once the coordinator has had
+ * BUS_TURNAROUND_MS to release the bus. The first tick can come right away, so
+ * one more is counted.
+ */
+void bus_poll_ISR(void)
+{
+	polls += 1;
+	reply_ticks = BUS_TURNAROUND_MS + 1;
+}
+
+/*!
+ * @brief Send a scheduled reply once the turnaround is over. Called every millisecond by TimerISR().
+ *
+ * @par
+ * Nothing else is transmitted in bus mode, so the reply always finds the
+ * transmit buffer empty. The driver is released by bus_tx_complete_ISR().
+ */
+void bus_tick_ISR(void)
+{
+	if (reply_ticks == 0 || --reply_ticks != 0)
+	{
+		return;
+	}
+
+	bus_transmit_enable();
+	if (frame_send(FRAME_STATUS, reply, BUS_STATUS_SIZE) != SUCCESS)
+	{
+		bus_transmit_disable();
+	}
+}
+
+/*!
+ * @brief Hand the bus back once the last reply byte has been sent.
+ */
+void bus_tx_complete_ISR(void)
+{
+	bus_transmit_disable();
+}
+
+/*!
+ * @brief Number of polls answered.
+ */
+uint16_t bus_polls(void)
+{
+	uint16_t count;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = polls;
+	}
+
+	return count;
+}
+
+/*** end of file ***/
@@ -0,0 +1,123 @@
+/**
+ * @file control.c
+ *
+ * @brief 
+ * Inbound control channel. See control.h for the commands.
+ */
+
+#include "control.h"
+#include "bus.h"
+#include "frame.h"
+#include "fsm.h"
+#include "log.h"
+#include "sampler.h"
+#include "telemetry.h"
+#include "uart.h"
+
+//FRAME_CMD_ACK frames received
+static uint16_t acks;
+
+static uint16_t get_u16(const uint8_t * p)
+{
+	return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint8_t set_param(const struct frame_msg * msg)
+{
+	if (msg->length != 3)
+	{
+		return FRAME_BAD_VALUE;
+	}
+
+	uint16_t value = get_u16(&msg->payload[1]);
+
+	switch(msg->payload[0])
+	{
+		case PARAM_TELEMETRY_PERIOD_S:
+			telemetry_set_period((uint32_t)value * 1000UL);
+			break;
+
+		case PARAM_OPEN_REPEAT_MS:
+			if (value == 0)
+			{
+				return FRAME_BAD_VALUE;
+			}
+			fsm_set_repeat(value);
+			break;
+
+		default:
+			return FRAME_BAD_COMMAND;
+	}
+
+	return FRAME_OK;
+}
+
+static uint8_t apply(const struct frame_msg * msg)
+{
+	switch(msg->type)
+	{
+		case FRAME_CMD_SET_PARAM:
+			return set_param(msg);
+
+		case FRAME_CMD_SAMPLE_RATE:
+			if (msg->length != 4)
+			{
+				return FRAME_BAD_VALUE;
+			}
+			//takes effect with the next sampler_update()
+			sampler_set_bounds(get_u16(&msg->payload[0]), get_u16(&msg->payload[2]));
+			return FRAME_OK;
+
+		case FRAME_CMD_TELEMETRY:
+			telemetry_request();
+			return FRAME_OK;
+
+		default:
+			return FRAME_BAD_COMMAND;
+	}
+}
+
+/*!
+ * @brief Apply every command received since the last call. Call once per main loop iteration.
+ *
+ * @par
+ * Commands come complete and checked from the receive interrupt, each one is a
+ * single dequeue. If an acknowledgement does not fit in the transmit buffer it is
+ * dropped; the ESP8266 repeats a command that is not acknowledged in time (see
+ * CommandSender in ESP8266/main/frame.h), so commands must be safe to apply twice.
+ */
+void control_poll(void)
+{
+	struct frame_msg msg;
+
+	frame_rx_tick();
+
+	while (frame_receive(&msg) == SUCCESS)
+	{
+		if (msg.type == FRAME_CMD_ACK)
+		{
+			acks += 1;
+			continue;
+		}
+
+		uint8_t status = apply(&msg);
+		LOG2("command %x, status %u", msg.type, status);
+#if BUS_MODE
+		//on the bus a node only transmits when polled
+		(void)status;
+#else
+		uint8_t reply[2] = {msg.type, status};
+		frame_send(FRAME_ACK, reply, sizeof(reply));
+#endif
+	}
+}
+
+/*!
+ * @brief Number of FRAME_CMD_ACK frames received from the ESP8266.
+ */
+uint16_t control_acks(void)
+{
+	return acks;
+}
+
+/*** end of file ***/
@@ -0,0 +1,249 @@
+/**
+ * @file frame.c
+ *
+ * @brief 
+ * Typed binary frames exchanged with the ESP8266. See frame.h for the layout.
+ */
+
+#include <util/atomic.h>
+
+#include "frame.h"
+#include "bus.h"
+#include "ring.h"
+#include "uart.h"
+
+enum rx_states {RX_IDLE, RX_ADDRESS, RX_TYPE, RX_LENGTH, RX_PAYLOAD, RX_CHECKSUM, RX_SKIP};
+
+RING_DEFINE(frame_queue, struct frame_msg, FRAME_QUEUE_SIZE)
+
+//number of frames that did not fit in the UART transmit buffer
+static uint16_t dropped;
+
+//receive state, only touched by the receive interrupt and frame_rx_tick()
+static enum rx_states rx_state;
+static struct frame_msg rx_msg;
+static uint8_t rx_count; //payload bytes received, or left to skip in RX_SKIP
+static uint8_t rx_checksum;
+static uint8_t rx_active; //bytes received since the last frame_rx_tick()
+static uint8_t rx_for_us; //bus mode, frame addressed to this node or broadcast
+static uint8_t rx_address;
+
+static frame_queue_t queue;
+static volatile struct frame_rx_stats rx_stats;
+
+/*!
+ * @brief Queue one frame for transmission.
+ * @param[in] type    Frame type, one of enum frame_type.
+ * @param[in] payload Payload bytes.
+ * @param[in] length  Number of payload bytes, at most FRAME_MAX_PAYLOAD.
+ * @return SUCCESS if the frame was queued, FAIL if it was too long or did not fit.
+ *
+ * @par
+ * Must only be called from the main loop, see uart_queue(). In bus mode nothing
+ * else transmits and it is only called by bus_tick_ISR(), from the timer ISR once
+ * BUS_TURNAROUND_MS has passed after a poll.
+ */
+int frame_send(uint8_t type, const uint8_t * payload, uint8_t length)
+{
+	char frame[FRAME_MAX_PAYLOAD + 5];
+	uint8_t checksum = type + length;
+	size_t sz = 0;
+
+	if (length > FRAME_MAX_PAYLOAD)
+	{
+		return FAIL;
+	}
+
+	frame[sz++] = (char)FRAME_SOF;
+#if BUS_MODE
+	frame[sz++] = (char)NODE_ID;
+	checksum   += NODE_ID;
+#endif
+	frame[sz++] = (char)type;
+	frame[sz++] = (char)length;
+
+	for (uint8_t i = 0; i < length; ++i)
+	{
+		frame[sz++] = (char)payload[i];
+		checksum += payload[i];
+	}
+	frame[sz++] = (char)checksum;
+
+	if (uart_queue(frame, sz) != SUCCESS)
+	{
+		dropped += 1;
+		return FAIL;
+	}
+
+	return SUCCESS;
+}
+
+/*!
+ * @brief Number of frames dropped because the transmit buffer was full.
+ */
+uint16_t frame_dropped(void)
+{
+	return dropped;
+}
+
+/*!
+ * @brief Feed one received byte to the frame parser. Called by uart_rx_complete_ISR().
+ * @param[in] byte Byte just received.
+ * @return 1 if the byte was part of a frame, 0 if it should be buffered as usual.
+ *
+ * @par
+ * Runs with interrupts disabled. A few compares per byte, the checksum is kept as
+ * the bytes arrive and a complete frame is copied into the queue once.
+ */
+int frame_receive_ISR(uint8_t byte)
+{
+	rx_active = 1;
+
+	switch(rx_state)
+	{
+		case RX_IDLE:
+			if (byte != FRAME_SOF)
+			{
+				return 0;
+			}
+			rx_checksum = 0;
+			rx_for_us   = 1;
+			rx_state    = BUS_MODE ? RX_ADDRESS : RX_TYPE;
+			break;
+
+		case RX_ADDRESS:
+			rx_address   = byte;
+			rx_for_us    = (byte == NODE_ID) || (byte == BUS_BROADCAST);
+			rx_checksum += byte;
+			rx_state     = RX_TYPE;
+			break;
+
+		case RX_TYPE:
+			rx_msg.type  = byte;
+			rx_checksum += byte;
+			rx_state     = RX_LENGTH;
+			break;
+
+		case RX_LENGTH:
+			if (byte > FRAME_CMD_PAYLOAD)
+			{
+				//too long to be a command, throw away the payload and checksum
+				rx_stats.errors += 1;
+				rx_count = byte;
+				rx_state = RX_SKIP;
+				break;
+			}
+			rx_msg.length = byte;
+			rx_count      = 0;
+			rx_checksum  += byte;
+			rx_state      = byte ? RX_PAYLOAD : RX_CHECKSUM;
+			break;
+
+		case RX_PAYLOAD:
+			rx_msg.payload[rx_count++] = byte;
+			rx_checksum += byte;
+			if (rx_count == rx_msg.length)
+			{
+				rx_state = RX_CHECKSUM;
+			}
+			break;
+
+		case RX_CHECKSUM:
+			rx_state = RX_IDLE;
+			if (byte != rx_checksum)
+			{
+				rx_stats.errors += 1;
+			}
+			else if (!rx_for_us)
+			{
+				//another node's traffic
+			}
+#if BUS_MODE
+			else if (rx_msg.type == FRAME_CMD_POLL)
+			{
+				//the reply is sent after the bus turnaround, see bus.h
+				if (rx_address == NODE_ID && rx_msg.length == 0)
+				{
+					bus_poll_ISR();
+				}
+			}
+#endif
+			else if (frame_queue_put(&queue, rx_msg) != 0)
+			{
+				rx_stats.dropped += 1;
+			}
+			else
+			{
+				rx_stats.frames += 1;
+			}
+			break;
+
+		case RX_SKIP:
+			//the checksum is the last byte skipped
+			if (rx_count == 0)
+			{
+				rx_state = RX_IDLE;
+			}
+			else
+			{
+				rx_count -= 1;
+			}
+			break;
+
+		default:
+			rx_state = RX_IDLE;
+			break;
+	}
+
+	return 1;
+}
+
+/*!
+ * @brief Discard a frame that stopped arriving. Call once per main loop iteration.
+ *
+ * @par
+ * A frame is sent in one go, so if nothing was received since the previous call
+ * the rest is not coming. The main loop period is much longer than a byte time.
+ */
+void frame_rx_tick(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (rx_state != RX_IDLE && !rx_active)
+		{
+			rx_stats.errors += 1;
+			rx_state = RX_IDLE;
+		}
+		rx_active = 0;
+	}
+}
+
+/*!
+ * @brief Take the oldest complete command off the queue.
+ * @param[out] msg Where the command is copied to.
+ * @return SUCCESS if a command was read, FAIL if the queue is empty.
+ *
+ * @par
+ * Must only be called from the main loop. The receive interrupt is the only
+ * producer, so no locking is needed (see ring.h).
+ */
+int frame_receive(struct frame_msg * msg)
+{
+	return (frame_queue_get(&queue, msg) == 0) ? SUCCESS : FAIL;
+}
+
+/*!
+ * @brief Copy the receive counters.
+ * @param[out] stats Where the counters are copied to.
+ */
+void frame_get_rx_stats(struct frame_rx_stats * stats)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		stats->frames  = rx_stats.frames;
+		stats->errors  = rx_stats.errors;
+		stats->dropped = rx_stats.dropped;
+	}
+}
+
+/*** end of file ***/
@@ -0,0 +1,124 @@
+/**
+ * @file fsm.c
+ *
+ * @brief 
+ * Door monitoring finite-state machine. Kept apart from main.c so that a single
+ * FSM step can be driven on its own (e.g. by the benchmark harness in bench/).
+ *
+ * See docs/door-status-notifier-state-machine.png for the state diagram.
+ */
+
+#include "fsm.h"
+
+static enum fsm_states state;
+static uint16_t cnt; //ms spent in OPEN01 since the last "OPEN" message
+static uint16_t repeat_ms = DELAY;
+
+/*!
+ * @brief Place the state machine in its initial state.
+ */
+void fsm_init(void)
+{
+	state = INIT;
+	cnt   = 0;
+}
+
+/*!
+ * @brief Change how often the "OPEN" message is repeated while the door stays open.
+ * @param[in] ms Repeat interval, DELAY until changed. Not reset by fsm_init().
+ */
+void fsm_set_repeat(uint16_t ms)
+{
+	repeat_ms = ms;
+}
+
+/*!
+ * @brief Run one FSM step (transition followed by actions).
+ * @param[in] curr_adc   Latest adc reading.
+ * @param[in] elapsed_ms Time since the previous step, the step period.
+ * @return Door status that should be reported for this step.
+ *
+ * @par
+ * The "OPEN" message is repeated based on elapsed time rather than on the number
+ * of steps, so the repeat rate does not depend on the sampling rate.
+ */
+door fsm_tick(uint8_t curr_adc, uint16_t elapsed_ms)
+{
+	door status = UNCHANGED;
+
+	switch(state) //transitions
+	{
+		case INIT:
+			cnt   = 0;
+			state = OPEN00;
+			break;
+
+		case OPEN00:
+			state = OPEN01;
+			break;
+
+		case OPEN01:
+			if (curr_adc > THRESHOLD)
+			{
+				state = CLOSED00;
+			}
+			else if (cnt >= repeat_ms)
+			{
+				state = OPEN00;
+			}
+			else
+			{
+				state = OPEN01;
+			}
+			break;
+
+		case CLOSED00:
+			state = CLOSED01;
+			break;
+
+		case CLOSED01:
+			if (curr_adc >= THRESHOLD)
+			{
+				state = CLOSED01;
+			}
+			else
+			{
+				state = OPEN00;
+			}
+			break;
+
+		default:
+			state = INIT;
+			break;
+	}
+
+	switch(state) //actions
+	{
+		case INIT:
+			break;
+
+		case OPEN00:
+			status = IS_OPEN;
+			cnt = 0;
+			break;
+
+		case OPEN01:
+			status = UNCHANGED;
+			cnt = (elapsed_ms >= (repeat_ms - cnt)) ? repeat_ms : (cnt + elapsed_ms);
+			break;
+
+		case CLOSED00:
+			status = IS_CLOSED;
+			break;
+
+		case CLOSED01:
+			status = UNCHANGED;
+			break;
+
+		default: break;
+	}
+
+	return status;
+}
+
+/*** end of file ***/
@@ -0,0 +1,48 @@
+/**
+ * @file hint.c
+ *
+ * @brief 
+ * "Approaching threshold" hint for the ESP8266. See hint.h.
+ */
+
+#include "hint.h"
+#include "fsm.h"
+
+static uint8_t  in_band;
+static uint16_t since_hint_ms; //saturates at HINT_HOLDOFF_MS
+
+/*!
+ * @brief Reset the hint state, the next reading inside the band sends a hint.
+ */
+void hint_init(void)
+{
+	in_band       = 0;
+	since_hint_ms = HINT_HOLDOFF_MS;
+}
+
+/*!
+ * @brief Check if a hint should be sent for this sample.
+ * @param[in] curr_adc   Latest adc reading.
+ * @param[in] elapsed_ms Time since the previous sample.
+ * @return 1 if a hint should be sent, 0 otherwise.
+ */
+int hint_update(uint8_t curr_adc, uint16_t elapsed_ms)
+{
+	uint8_t was_in_band = in_band;
+
+	in_band = ((int)curr_adc >= (THRESHOLD - HINT_BAND)) &&
+	          ((int)curr_adc <= (THRESHOLD + HINT_BAND));
+
+	since_hint_ms = (elapsed_ms >= (HINT_HOLDOFF_MS - since_hint_ms)) ? HINT_HOLDOFF_MS
+	                                                                  : (since_hint_ms + elapsed_ms);
+
+	if (in_band && (!was_in_band || since_hint_ms >= HINT_HOLDOFF_MS))
+	{
+		since_hint_ms = 0;
+		return 1;
+	}
+
+	return 0;
+}
+
+/*** end of file ***/
@@ -0,0 +1,256 @@
+/**
+ * @file link.c
+ *
+ * @brief 
+ * Event delivery to an ESP8266 that spends its time in deep sleep. See link.h for
+ * the handshake.
+ */
+
+#include "link.h"
+#include "atmega168_gpio.h"
+#include "frame.h"
+#include "log.h"
+#include "ring.h"
+#include "timer.h"
+#include "uart.h"
+
+enum link_states {LINK_IDLE, LINK_WAKE, LINK_WAIT_READY, LINK_WAIT_ACK};
+
+RING_DEFINE(event_ring, char, LINK_QUEUE_SIZE)
+
+static event_ring_t events;
+static char last_queued;
+static enum link_states state;
+static uint8_t attempts;     //wake-ups tried for the event at the head of the queue
+static uint8_t ready_seen;
+static uint8_t ack_seen;
+static uint32_t start_us;    //delivery of the head event started, for the latency
+static uint32_t since_us;    //current state entered, for the timeouts
+static struct link_stats stats;
+
+static void wake(uint32_t now)
+{
+	if (attempts == 0)
+	{
+		start_us = now;
+	}
+
+	assert_wake_line();
+	ready_seen = 0;
+	since_us = now;
+	state = LINK_WAKE;
+}
+
+static void send_next(uint32_t now)
+{
+	uart_send(*event_ring_peek(&events));
+	ack_seen = 0;
+	since_us = now;
+	state = LINK_WAIT_ACK;
+}
+
+static void put_u16(uint8_t * p, uint16_t value)
+{
+	p[0] = (uint8_t)(value & 0xFF);
+	p[1] = (uint8_t)(value >> 8);
+}
+
+static void send_stats(void)
+{
+	uint8_t payload[10];
+
+	put_u16(&payload[0], stats.delivered);
+	put_u16(&payload[2], stats.dropped);
+	put_u16(&payload[4], stats.retries);
+	put_u16(&payload[6], stats.last_latency_ms);
+	put_u16(&payload[8], stats.max_latency_ms);
+
+	//best effort, the next delivery sends newer counters anyway
+	frame_send(FRAME_LINK_STATS, payload, sizeof(payload));
+}
+
+static void retry(uint32_t now)
+{
+	attempts += 1;
+	stats.retries += 1;
+
+	if (attempts > LINK_RETRIES)
+	{
+		//give up on this event, the ESP8266 is not answering
+		char dropped;
+		event_ring_get(&events, &dropped);
+		stats.dropped += 1;
+		attempts = 0;
+		LOG1("link dropped '%c', no answer from ESP8266", dropped);
+	}
+
+	if (event_ring_empty(&events))
+	{
+		state = LINK_IDLE;
+	}
+	else
+	{
+		wake(now);
+	}
+}
+
+/*!
+ * @brief Initialize the wake line and empty the event queue.
+ */
+void link_init(void)
+{
+	create_wake_line();
+	event_ring_reset(&events);
+
+	last_queued = 0;
+	state       = LINK_IDLE;
+	attempts    = 0;
+	ready_seen  = 0;
+	ack_seen    = 0;
+
+	stats.delivered       = 0;
+	stats.dropped         = 0;
+	stats.retries         = 0;
+	stats.last_latency_ms = 0;
+	stats.max_latency_ms  = 0;
+}
+
+/*!
+ * @brief Queue an event for delivery.
+ * @param[in] event Status message to deliver ('o' or 'c').
+ * @return SUCCESS if queued, FAIL if the queue was full.
+ *
+ * @par
+ * An event identical to the last one still waiting in the queue is not queued
+ * again, so repeated "OPEN" messages do not pile up while the ESP8266 wakes up.
+ */
+int link_post(char event)
+{
+	if (!event_ring_empty(&events) && event == last_queued)
+	{
+		return SUCCESS;
+	}
+
+	if (event_ring_put(&events, event) != 0)
+	{
+		stats.dropped += 1;
+		return FAIL;
+	}
+
+	last_queued = event;
+	return SUCCESS;
+}
+
+/*!
+ * @brief Handle one byte received from the ESP8266.
+ * @param[in] data Byte read from the UART.
+ */
+void link_receive(char data)
+{
+	if (data == LINK_READY && state == LINK_WAIT_READY)
+	{
+		ready_seen = 1;
+	}
+	else if (data == LINK_ACK && state == LINK_WAIT_ACK)
+	{
+		ack_seen = 1;
+	}
+}
+
+/*!
+ * @brief Advance the handshake. Call once per main loop iteration.
+ *
+ * @par
+ * The wake line stays asserted for one main loop iteration, at least SAMPLER_MIN_MS.
+ */
+void link_tick(void)
+{
+	uint32_t now = timer_micros();
+	uint32_t waited_ms = (now - since_us) / 1000;
+
+	switch(state)
+	{
+		case LINK_IDLE:
+			if (!event_ring_empty(&events))
+			{
+				attempts = 0;
+				wake(now);
+			}
+			break;
+
+		case LINK_WAKE:
+			release_wake_line();
+			since_us = now;
+			state = LINK_WAIT_READY;
+			break;
+
+		case LINK_WAIT_READY:
+			if (ready_seen)
+			{
+				send_next(now);
+			}
+			else if (waited_ms >= LINK_READY_TIMEOUT_MS)
+			{
+				retry(now);
+			}
+			break;
+
+		case LINK_WAIT_ACK:
+			if (ack_seen)
+			{
+				char delivered;
+				event_ring_get(&events, &delivered);
+
+				uint32_t latency_ms = (now - start_us) / 1000;
+				stats.last_latency_ms = (latency_ms > 0xFFFF) ? 0xFFFF : (uint16_t)latency_ms;
+				if (stats.last_latency_ms > stats.max_latency_ms)
+				{
+					stats.max_latency_ms = stats.last_latency_ms;
+				}
+				stats.delivered += 1;
+				LOG2("link delivered '%c' in %u ms", delivered, stats.last_latency_ms);
+				attempts = 0;
+
+				if (event_ring_empty(&events))
+				{
+					send_stats();
+					state = LINK_IDLE;
+				}
+				else
+				{
+					//ESP8266 is still awake, no need to wake it up again
+					start_us = now;
+					send_next(now);
+				}
+			}
+			else if (waited_ms >= LINK_ACK_TIMEOUT_MS)
+			{
+				retry(now);
+			}
+			break;
+
+		default:
+			state = LINK_IDLE;
+			break;
+	}
+}
+
+/*!
+ * @brief Check if the link still has work to do.
+ * @return Non-zero while events are queued or a handshake is in progress.
+ */
+int link_busy(void)
+{
+	return (state != LINK_IDLE) || !event_ring_empty(&events);
+}
+
+/*!
+ * @brief Copy the delivery counters.
+ * @param[out] p_stats Pointer to struct where the counters are to be stored.
+ */
+void link_get_stats(struct link_stats * p_stats)
+{
+	*p_stats = stats;
+}
+
+/*** end of file ***/
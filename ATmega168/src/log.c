@@ -0,0 +1,57 @@
+/**
+ * @file log.c
+ *
+ * @brief 
+ * Deferred binary logging for the ATmega168. Builds the log frames described in
+ * log.h and hands them to the UART transmit buffer, which is drained by the
+ * transmit interrupt.
+ */
+
+#include "log.h"
+#include "uart.h"
+
+//number of frames that did not fit in the UART transmit buffer
+static uint16_t dropped;
+
+/*!
+ * @brief Queue one log frame. Use the LOG0() to LOG3() macros instead of calling directly.
+ * @param[in] id   Flash address of the format string.
+ * @param[in] argc Number of arguments used (0 - 3).
+ * @param[in] a0   First argument.
+ * @param[in] a1   Second argument.
+ * @param[in] a2   Third argument.
+ *
+ * @par
+ * Must only be called from the main loop, see uart_queue().
+ */
+void log_write(uint16_t id, uint8_t argc, uint16_t a0, uint16_t a1, uint16_t a2)
+{
+	char frame[9];
+	uint16_t args[3] = {a0, a1, a2};
+	size_t sz = 0;
+
+	frame[sz++] = (char)LOG_SOF;
+	frame[sz++] = (char)(id & 0xFF);
+	frame[sz++] = (char)(id >> 8);
+
+	for (uint8_t i = 0; i < argc && i < 3; ++i)
+	{
+		frame[sz++] = (char)(args[i] & 0xFF);
+		frame[sz++] = (char)(args[i] >> 8);
+	}
+
+	if (uart_queue(frame, sz) != SUCCESS)
+	{
+		dropped += 1;
+	}
+}
+
+/*!
+ * @brief Number of log frames dropped because the transmit buffer was full.
+ */
+uint16_t log_dropped(void)
+{
+	return dropped;
+}
+
+/*** end of file ***/
@@ -4,133 +4,163 @@
 
 #include <stdint.h>
 #include "adc.h"
+#include "bus.h"
+#include "control.h"
+#include "fsm.h"
+#include "hint.h"
+#include "link.h"
+#include "log.h"
+#include "sampler.h"
+#include "telemetry.h"
 #include "timer.h"
+#include "trace.h"
 #include "uart.h"
 
 #define BAUD      9600
-#define PERIOD    1000 // 1 sec FSM tick rate
-#define THRESHOLD 100  //adc threshold for determining if door is open or closed
-#define DELAY     2    //used to delay the sending of another "OPEN" message
-
-enum fsm_states {INIT, OPEN00, OPEN01, CLOSED00, CLOSED01} state;
-typedef enum door_status {IS_OPEN, IS_CLOSED, UNCHANGED} door;
 
+static void deliver(char message);
 static void send_status(door status);
+static void serve_requests(void);
 
 int main(void)
 {
 	//initialize peripherals
 	adc_init();
 	uart_init(BAUD);
-	timer_init(PERIOD);
+	sampler_init();
+	timer_init(sampler_period());
+	fsm_init();
+	hint_init();
+	telemetry_init();
+#if ESP_DEEP_SLEEP
+	link_init();
+#endif
+#if BUS_MODE
+	bus_init();
+#endif
+#if TRACE_ENABLE
+	trace_init();
+#endif
 
 	//shared variables
 	uint8_t curr_adc;
-	int cnt = 0;
-	state = INIT;
-	door status = IS_OPEN; 
+	door status;
+	uint16_t period = sampler_period();
+	uint32_t wake_us;
+
+	LOG1("boot, period %u ms", period);
 
 	timer_on();
 	
 	while(1)
 	{
+		wake_us = timer_micros();
+
 		//get input
+		TRACE(TRACE_ADC_BEGIN);
 		curr_adc = adc_read();
+		TRACE(TRACE_ADC_END);
 
-		switch(state) //transitions
-		{
-			case INIT:
-				curr_adc = 0;
-				cnt      = 0;
-				status   = IS_OPEN;
-				state    = OPEN00;
-				break;
-
-			case OPEN00:
-				state = OPEN01;
-				break;
-
-			case OPEN01:
-				if (curr_adc > THRESHOLD)
-				{
-					state = CLOSED00;
-				}
-				else if (cnt == DELAY)
-				{
-					state = OPEN00;
-				}
-				else
-				{
-					state = OPEN01;
-				}
-				break;
-
-			case CLOSED00:
-				state = CLOSED01;
-				break;
+		//transitions and actions
+		TRACE(TRACE_FSM_BEGIN);
+		status = fsm_tick(curr_adc, period);
+		TRACE(TRACE_FSM_END);
 
-			case CLOSED01:
-				if (curr_adc >= THRESHOLD)
-				{
-					state = CLOSED01;
-				}
-				else
-				{
-					state = OPEN00;
-				}
-				break;
+		//output
+		TRACE(TRACE_SEND_BEGIN);
+		send_status(status);
+		TRACE(TRACE_SEND_END);
 
-			default:
-				state = INIT;
-				break;
+		if (status != UNCHANGED)
+		{
+			LOG2("adc %u, status %u", curr_adc, status);
 		}
 
-		switch(state) //actions
+#if BUS_MODE
+		//state for the next poll, see bus.h
+		bus_post(status, curr_adc);
+#elif !ESP_DEEP_SLEEP
+		//let the ESP8266 open its connection early, never worth waking it up for
+		if (hint_update(curr_adc, period))
 		{
-			case INIT:
-				break;
-
-			case OPEN00:
-				status = IS_OPEN;
-				cnt = 0;
-				break;
-
-			case OPEN01:
-				status = UNCHANGED;
-				cnt += 1;
-				break;
+			const char hint = HINT_MESSAGE;
+			uart_queue(&hint, 1);
+		}
 
-			case CLOSED00:
-				status = IS_CLOSED;
-				break;
+		//a few bytes per minute, summarized by the ESP8266
+		telemetry_sample(curr_adc, status, period);
+#endif
 
-			case CLOSED01:
-				status = UNCHANGED;
-				break;
+		serve_requests();
+		control_poll();
 
-			default: break;
+		//pick the next sampling period based on door activity
+		uint16_t next = sampler_update(curr_adc, status, timer_micros() - wake_us);
+#if ESP_DEEP_SLEEP
+		link_tick();
+		if (link_busy())
+		{
+			//poll the handshake at the fast rate
+			sampler_poke();
+			next = sampler_period();
+		}
+#endif
+		if (next != period)
+		{
+			timer_set_period(next);
+			LOG2("period %u ms, duty %u permille", next, sampler_duty_permille());
+			period = next;
 		}
 
-		//output
-		send_status(status);
-
-		while(!TimerFlag);
-		TimerFlag = 0;
+		TRACE(TRACE_IDLE_BEGIN);
+		timer_wait();
+		TRACE(TRACE_IDLE_END);
 	}
 }
 
+static void deliver(char message)
+{
+#if BUS_MODE
+	//nodes only talk when polled, the state goes out with bus_post()
+	(void)message;
+#elif ESP_DEEP_SLEEP
+	//ESP8266 is asleep, delivered by the wake handshake instead, see link.h
+	link_post(message);
+#else
+	uart_send(message);
+#endif
+}
+
 static void send_status(door status)
 {
 	switch(status)
 		{
 			case IS_OPEN:
-				uart_send('o'); // o for open
+				deliver('o'); // o for open
 				break;
 			case IS_CLOSED:
-				uart_send('c'); // c for closed
+				deliver('c'); // c for closed
 				break;
 			case UNCHANGED:
 				break;
 			default: break;
 		}
-}
\ No newline at end of file
+}
+
+static void serve_requests(void)
+{
+	char request;
+
+	while (uart_read(&request) == SUCCESS)
+	{
+#if TRACE_ENABLE
+		if (request == TRACE_REQUEST)
+		{
+			trace_dump();
+		}
+#endif
+#if ESP_DEEP_SLEEP
+		link_receive(request);
+#endif
+	}
+}
@@ -0,0 +1,207 @@
+/**
+ * @file sampler.c
+ *
+ * @brief 
+ * Activity-adaptive sampling rate controller. See sampler.h.
+ */
+
+#include "sampler.h"
+
+static uint16_t fast_ms;
+static uint16_t slow_ms;
+static uint16_t period;
+static uint16_t quiet_ms;    //time since the last activity, saturates at SAMPLER_HOLD_MS
+static uint8_t  prev_adc;
+static uint8_t  first_sample;
+static door     last_status; //last IS_OPEN/IS_CLOSED reported by the FSM
+static struct sampler_stats stats;
+
+static uint16_t clamp(uint16_t value)
+{
+	if (value < SAMPLER_MIN_MS)
+	{
+		return SAMPLER_MIN_MS;
+	}
+	if (value > SAMPLER_MAX_MS)
+	{
+		return SAMPLER_MAX_MS;
+	}
+	return value;
+}
+
+/*!
+ * @brief Decide if the latest sample shows activity at the door.
+ */
+static int is_active(uint8_t curr_adc, door status)
+{
+	//door actually changed state, repeated "OPEN" messages do not count
+	if (status != UNCHANGED && status != last_status)
+	{
+		return 1;
+	}
+
+	//reading close enough to THRESHOLD that the door may be about to change state
+	if ((int)curr_adc >= (THRESHOLD - SAMPLER_BAND) &&
+	    (int)curr_adc <= (THRESHOLD + SAMPLER_BAND))
+	{
+		return 1;
+	}
+
+	//door is moving
+	int delta = (int)curr_adc - (int)prev_adc;
+	if (!first_sample && (delta > SAMPLER_DELTA || delta < -SAMPLER_DELTA))
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+/*!
+ * @brief Reset the controller to the default bounds, starting at the slow period.
+ */
+void sampler_init(void)
+{
+	fast_ms      = SAMPLER_FAST_MS;
+	slow_ms      = SAMPLER_SLOW_MS;
+	period       = SAMPLER_SLOW_MS;
+	quiet_ms     = SAMPLER_HOLD_MS;
+	prev_adc     = 0;
+	first_sample = 1;
+	last_status  = UNCHANGED;
+
+	stats.samples    = 0;
+	stats.elapsed_ms = 0;
+	stats.fast_ms    = 0;
+	stats.awake_us   = 0;
+}
+
+/*!
+ * @brief Change the fast and slow periods.
+ * @param[in] fast Period used while the door is active, in ms.
+ * @param[in] slow Period the controller decays to while idle, in ms.
+ *
+ * @par
+ * Both values are clamped to SAMPLER_MIN_MS - SAMPLER_MAX_MS and swapped if fast is
+ * larger than slow.
+ */
+void sampler_set_bounds(uint16_t fast, uint16_t slow)
+{
+	fast = clamp(fast);
+	slow = clamp(slow);
+
+	fast_ms = (fast < slow) ? fast : slow;
+	slow_ms = (fast < slow) ? slow : fast;
+
+	if (period < fast_ms)
+	{
+		period = fast_ms;
+	}
+	else if (period > slow_ms)
+	{
+		period = slow_ms;
+	}
+}
+
+/*!
+ * @brief Feed one sample to the controller and get the period until the next one.
+ * @param[in] curr_adc Latest adc reading.
+ * @param[in] status   Door status returned by fsm_tick() for this sample.
+ * @param[in] awake_us Time the MCU spent awake handling this sample.
+ * @return Period until the next sample in ms, for timer_set_period().
+ *
+ * @par
+ * Any activity switches straight to the fast period. After SAMPLER_HOLD_MS without
+ * activity the period doubles every sample until it reaches the slow period.
+ */
+uint16_t sampler_update(uint8_t curr_adc, door status, uint32_t awake_us)
+{
+	//halve the counters before they overflow, the ratios between them are kept
+	if (stats.awake_us > 0x7FFFFFFFUL || stats.elapsed_ms > 0x7FFFFFFFUL)
+	{
+		stats.samples    /= 2;
+		stats.elapsed_ms /= 2;
+		stats.fast_ms    /= 2;
+		stats.awake_us   /= 2;
+	}
+
+	stats.samples    += 1;
+	stats.elapsed_ms += period;
+	stats.awake_us   += awake_us;
+	if (period == fast_ms)
+	{
+		stats.fast_ms += period;
+	}
+
+	if (is_active(curr_adc, status))
+	{
+		period   = fast_ms;
+		quiet_ms = 0;
+	}
+	else if (quiet_ms < SAMPLER_HOLD_MS)
+	{
+		quiet_ms = (period >= (SAMPLER_HOLD_MS - quiet_ms)) ? SAMPLER_HOLD_MS
+		                                                    : (quiet_ms + period);
+	}
+	else
+	{
+		period = (period >= (slow_ms / 2)) ? slow_ms : (period * 2);
+	}
+
+	prev_adc     = curr_adc;
+	first_sample = 0;
+	if (status != UNCHANGED)
+	{
+		last_status = status;
+	}
+
+	return period;
+}
+
+/*!
+ * @brief Report activity that the adc readings cannot show, e.g. a pending handshake.
+ *
+ * @par
+ * Switches to the fast period and restarts the hold time, exactly like activity
+ * seen by sampler_update(). Read the new period with sampler_period().
+ */
+void sampler_poke(void)
+{
+	period   = fast_ms;
+	quiet_ms = 0;
+}
+
+/*!
+ * @brief Current sampling period in ms.
+ */
+uint16_t sampler_period(void)
+{
+	return period;
+}
+
+/*!
+ * @brief Copy the counters kept since sampler_init().
+ * @param[out] p_stats Pointer to struct where the counters are to be stored.
+ */
+void sampler_get_stats(struct sampler_stats * p_stats)
+{
+	*p_stats = stats;
+}
+
+/*!
+ * @brief Fraction of time the MCU was awake, in thousandths.
+ */
+uint16_t sampler_duty_permille(void)
+{
+	if (stats.elapsed_ms == 0)
+	{
+		return 0;
+	}
+
+	//awake_us / (elapsed_ms * 1000) * 1000
+	uint32_t duty = stats.awake_us / stats.elapsed_ms;
+
+	return (duty > 1000) ? 1000 : (uint16_t)duty;
+}
+
+/*** end of file ***/
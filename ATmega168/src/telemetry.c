@@ -0,0 +1,141 @@
+/**
+ * @file telemetry.c
+ *
+ * @brief 
+ * Periodic health telemetry for the ESP8266. See telemetry.h for the record layout.
+ */
+
+#include "telemetry.h"
+#include "frame.h"
+#include "sampler.h"
+#include "uart.h"
+
+struct telemetry_window
+{
+	uint8_t  adc_min;
+	uint8_t  adc_max;
+	uint32_t adc_sum;
+	uint16_t samples;
+	uint8_t  transitions;
+	uint32_t elapsed_ms;
+};
+
+static struct telemetry_window window;
+static uint16_t last_overruns;
+static uint32_t uptime_ms;
+static uint32_t period_ms = TELEMETRY_PERIOD_MS;
+static uint8_t  requested;
+static door     last_status; //last IS_OPEN/IS_CLOSED, the FSM repeats IS_OPEN
+
+static void reset_window(void)
+{
+	window.adc_min     = 0xFF;
+	window.adc_max     = 0;
+	window.adc_sum     = 0;
+	window.samples     = 0;
+	window.transitions = 0;
+	window.elapsed_ms  = 0;
+}
+
+static void put_u16(uint8_t * p, uint16_t value)
+{
+	p[0] = (uint8_t)(value & 0xFF);
+	p[1] = (uint8_t)(value >> 8);
+}
+
+/*!
+ * @brief Start the first telemetry window.
+ */
+void telemetry_init(void)
+{
+	reset_window();
+	last_overruns = uart_rx_overruns();
+	uptime_ms     = 0;
+	requested     = 0;
+	last_status   = UNCHANGED;
+}
+
+/*!
+ * @brief Change how often a record is sent.
+ * @param[in] period Time between records in ms, 0 to only send requested records.
+ */
+void telemetry_set_period(uint32_t period)
+{
+	period_ms = period;
+}
+
+/*!
+ * @brief Send the current window with the next sample instead of waiting for the period.
+ */
+void telemetry_request(void)
+{
+	requested = 1;
+}
+
+/*!
+ * @brief Add one sample to the current window, send the record once the period is over.
+ * @param[in] curr_adc   Latest adc reading.
+ * @param[in] status     Result of fsm_tick() for this sample.
+ * @param[in] elapsed_ms Time since the previous sample.
+ *
+ * @par
+ * Must only be called from the main loop, see uart_queue(). If the record does not
+ * fit in the transmit buffer the window is kept and sending is retried next sample.
+ */
+void telemetry_sample(uint8_t curr_adc, door status, uint16_t elapsed_ms)
+{
+	if (curr_adc < window.adc_min)
+	{
+		window.adc_min = curr_adc;
+	}
+	if (curr_adc > window.adc_max)
+	{
+		window.adc_max = curr_adc;
+	}
+	window.adc_sum += curr_adc;
+	if (window.samples < UINT16_MAX)
+	{
+		window.samples += 1;
+	}
+	if (status != UNCHANGED && status != last_status)
+	{
+		//the first report after boot is not a change
+		if (last_status != UNCHANGED && window.transitions < UINT8_MAX)
+		{
+			window.transitions += 1;
+		}
+		last_status = status;
+	}
+	window.elapsed_ms += elapsed_ms;
+	uptime_ms         += elapsed_ms;
+
+	if (!requested && (period_ms == 0 || window.elapsed_ms < period_ms))
+	{
+		return;
+	}
+
+	uint8_t record[TELEMETRY_SIZE];
+	cbuf_stats_t rx;
+	uart_rx_stats(&rx);
+	uint16_t overruns = rx.overruns - last_overruns;
+
+	record[0] = TELEMETRY_VERSION;
+	record[1] = window.adc_min;
+	record[2] = window.adc_max;
+	record[3] = (uint8_t)(window.adc_sum / window.samples);
+	put_u16(&record[4], window.samples);
+	record[6] = window.transitions;
+	record[7] = (overruns > UINT8_MAX) ? UINT8_MAX : (uint8_t)overruns;
+	put_u16(&record[8], sampler_duty_permille());
+	put_u16(&record[10], (uint16_t)(uptime_ms / 60000UL));
+	record[12] = (rx.high_water > UINT8_MAX) ? UINT8_MAX : (uint8_t)rx.high_water;
+
+	if (frame_send(FRAME_TELEMETRY, record, TELEMETRY_SIZE) == SUCCESS)
+	{
+		last_overruns += overruns;
+		requested = 0;
+		reset_window();
+	}
+}
+
+/*** end of file ***/
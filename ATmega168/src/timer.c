@@ -10,6 +10,10 @@
  */
 
 #include "timer.h"
+#include "bus.h"
+
+//set by TimerISR once every period, cleared by the user
+volatile uint8_t TimerFlag;
 
 //used to determine length of period. Set by user.
 static uint16_t avr_timer_count;
@@ -17,6 +21,13 @@ static uint16_t avr_timer_count;
 //used to count down to 0, starts at avr_timer_count
 static volatile uint16_t avr_timer_curr_count = 1;
 
+//milliseconds elapsed since timer_on(), used by timer_micros()
+static volatile uint32_t avr_timer_ms;
+
+//timer ticks per millisecond and microseconds per tick, see atmega168_timer.c
+#define TICKS_PER_MS 125
+#define US_PER_TICK  8
+
 /*!
  * @brief Initialize timer peripheral and 2 global variables
  * @param[in] period Period duration in milliseconds
@@ -36,6 +47,7 @@ void timer_on(void)
 {
 	//initialize count down variable
 	avr_timer_curr_count = avr_timer_count;
+	avr_timer_ms = 0;
 	on();
 }
 
@@ -48,6 +60,68 @@ void timer_off(void)
 	off();
 }
 
+/*!
+ * @brief Change the period while the timer is running.
+ * @param[in] period New period duration in milliseconds
+ *
+ * @par
+ * If the current period has more time left than the new period, it is shortened
+ * so that a faster rate takes effect right away. Must only be called after
+ * timer_on().
+ */
+void timer_set_period(uint16_t period)
+{
+	disable_timer_interrupt();
+
+	avr_timer_count = period;
+	if (avr_timer_curr_count > period)
+	{
+		avr_timer_curr_count = period;
+	}
+
+	enable_timer_interrupt();
+}
+
+/*!
+ * @brief Sleep until the end of the current period, then reset TimerFlag.
+ *
+ * @par
+ * The MCU is put in idle mode between timer interrupts instead of spinning.
+ */
+void timer_wait(void)
+{
+	while(!TimerFlag)
+	{
+		idle();
+	}
+	TimerFlag = 0;
+}
+
+/*!
+ * @brief Time since timer_on() in microseconds, with 8us resolution.
+ *
+ * @par
+ * Wraps after about 71 minutes, use differences between two calls. Must only be
+ * called after timer_on().
+ */
+uint32_t timer_micros(void)
+{
+	disable_timer_interrupt();
+
+	uint32_t ms    = avr_timer_ms;
+	uint8_t  ticks = read_timer();
+
+	//counter already restarted but the interrupt counting that millisecond has not run
+	if (compare_pending() && ticks < (TICKS_PER_MS / 2))
+	{
+		ms += 1;
+	}
+
+	enable_timer_interrupt();
+
+	return (ms * 1000) + ((uint32_t)ticks * US_PER_TICK);
+}
+
 /*!
  * @brief 
  * Called by interrupt handler every millisecond. Only sets TimerFlag to 1 after
@@ -58,6 +132,7 @@ void timer_off(void)
  */
 void TimerISR(void)
 {
+	avr_timer_ms += 1;
 	avr_timer_curr_count -= 1;
 
 	if(avr_timer_curr_count == 0)
@@ -65,6 +140,10 @@ void TimerISR(void)
 		TimerFlag = 1;
 		avr_timer_curr_count = avr_timer_count;
 	}
+
+#if BUS_MODE
+	bus_tick_ISR();
+#endif
 }
 
 /*** end of file ***/
\ No newline at end of file
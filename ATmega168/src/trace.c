@@ -0,0 +1,99 @@
+/**
+ * @file trace.c
+ *
+ * @brief 
+ * Optional ISR and main loop trace for the ATmega168. See trace.h for the dump
+ * format.
+ */
+
+#include <util/atomic.h>
+
+#include "trace.h"
+#include "atmega168_timer.h"
+#include "ring.h"
+#include "uart.h"
+
+struct trace_record
+{
+	uint8_t  event;
+	uint16_t timestamp;
+};
+
+RING_DEFINE(trace_ring, struct trace_record, TRACE_DEPTH)
+
+//keeps the most recent TRACE_DEPTH records, oldest ones are overwritten
+static trace_ring_t ring;
+static volatile uint8_t paused;
+
+/*!
+ * @brief Start the timestamp counter and empty the trace ring.
+ */
+void trace_init(void)
+{
+	trace_ring_reset(&ring);
+	paused = 0;
+
+	create_counter();
+}
+
+/*!
+ * @brief Record one event, overwriting the oldest one when the ring is full.
+ * @param[in] event One of enum trace_event.
+ *
+ * @par
+ * Safe to call from both interrupt handlers and the main loop.
+ */
+void trace_record(uint8_t event)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (!paused)
+		{
+			struct trace_record record = {event, read_counter()};
+			trace_ring_push(&ring, record);
+		}
+	}
+}
+
+/*!
+ * @brief Send the recorded events over the UART, oldest first, then empty the ring.
+ *
+ * @par
+ * Blocks until the whole dump has been sent. Must be called from the main loop.
+ */
+void trace_dump(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		paused = 1;
+	}
+
+	uint8_t count = trace_ring_size(&ring);
+	uint8_t checksum = count;
+	struct trace_record record;
+
+	uart_send((char)TRACE_SOF);
+	uart_send((char)count);
+
+	while (trace_ring_get(&ring, &record) == 0)
+	{
+		uint8_t bytes[3] = {record.event,
+		                    (uint8_t)(record.timestamp & 0xFF),
+		                    (uint8_t)(record.timestamp >> 8)};
+
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			uart_send((char)bytes[j]);
+			checksum += bytes[j];
+		}
+	}
+
+	uart_send((char)checksum);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		paused = 0;
+	}
+}
+
+/*** end of file ***/
@@ -9,13 +9,22 @@
  * Note: requires CircularBuffer.c and CircularBuffer.h which can be found in github.
  */
 
+#include <avr/io.h>
+#include <util/atomic.h>
+
 #include "uart.h"
 #include "atmega168_uart.h"
+#include "bus.h"
+#include "frame.h"
 
 //circular buffer used to store incoming data
 //
 static volatile cbuf_handle_t cbuf;
 
+//circular buffer holding data queued for interrupt driven transmission
+//
+static volatile cbuf_handle_t txbuf;
+
 /*!
  * @brief Initialize microcontroller USART module and receive buffer.
  * @param[in] baud_rate - User specified baud rate.
@@ -30,6 +39,11 @@ void uart_init(uint32_t baud_rate)
 	create_uart(baud_rate);
 	char * buffer = malloc(sizeof(char) * CBUF_SIZE);
 	cbuf = circular_buf_init(buffer, CBUF_SIZE);
+	circular_buf_set_policy(cbuf, RX_OVERFLOW_POLICY);
+	char * tx_buffer = malloc(sizeof(char) * TX_CBUF_SIZE);
+	txbuf = circular_buf_init(tx_buffer, TX_CBUF_SIZE);
+	//uart_queue() checks for room first, a rejected byte would be a bug
+	circular_buf_set_policy(txbuf, CBUF_REJECT);
 }
 
 /*!
@@ -42,7 +56,9 @@ void uart_init(uint32_t baud_rate)
 void uart_terminate(void)
 {
 	destroy();
+	disable_tx_interrupt();
 	circular_buf_free(cbuf);
+	circular_buf_free(txbuf);
 }
 
 /*!
@@ -57,9 +73,26 @@ BOOL uart_send_ready(void)
 /*!
  * @brief Transmit one character.
  * @param[in] data - Character to be transmitted.
+ *
+ * @par
+ * Anything previously queued with uart_queue() is transmitted first. With
+ * interrupts disabled (in an ISR or a critical section) the TX interrupt cannot
+ * drain the queue, so the queued bytes are sent from here instead of waiting.
  */
 void uart_send(char data)
 {
+	if (!(SREG & _BV(SREG_I)))
+	{
+		char queued;
+
+		while (circular_buf_get(txbuf, &queued) == 0)
+		{
+			while(!(is_send_ready()));
+			send(queued);
+		}
+	}
+
+	while(!circular_buf_empty(txbuf));
 	while(!(is_send_ready()));
 
 	send(data);
@@ -103,6 +136,41 @@ int uart_send_string(char * str, size_t sz)
 	return SUCCESS;
 }
 
+/*!
+ * @brief Queue data for interrupt driven transmission.
+ * @param[in] data - Pointer to the bytes to be transmitted.
+ * @param[in] sz   - Number of bytes to transmit.
+ * @return SUCCESS if all bytes were queued, FAIL if there was not enough room.
+ *
+ * @par
+ * Returns without waiting for the data to be sent. Data is either queued as a
+ * whole or not at all, so a partial message is never transmitted.
+ * Must only be called from the main loop, not from an interrupt handler.
+ */
+int uart_queue(const char * data, size_t sz)
+{
+	//keep the transmit interrupt from reading the buffer while it is updated
+	disable_tx_interrupt();
+
+	int status = FAIL;
+
+	if ((circular_buf_capacity(txbuf) - circular_buf_size(txbuf)) >= sz)
+	{
+		for (size_t i = 0; i < sz; ++i)
+		{
+			circular_buf_put(txbuf, data[i]);
+		}
+		status = SUCCESS;
+	}
+
+	if (!circular_buf_empty(txbuf))
+	{
+		enable_tx_interrupt();
+	}
+
+	return status;
+}
+
 /*!
  * @brief Find the amount of characters currently available for reading
  * @return The amount of characters available in buffer.
@@ -112,6 +180,50 @@ size_t uart_available(void)
 	return (size_t)circular_buf_size(cbuf);
 }
 
+/*!
+ * @brief Read the receive buffer overrun and high-water counters.
+ * @param[out] stats - Where the counters are copied to.
+ *
+ * @par
+ * The counters are updated by the receive interrupt, they are copied with
+ * interrupts disabled so the two bytes of each counter always match.
+ */
+void uart_rx_stats(cbuf_stats_t * stats)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		circular_buf_stats(cbuf, stats);
+	}
+}
+
+/*!
+ * @brief Read the transmit buffer overrun and high-water counters.
+ * @param[out] stats - Where the counters are copied to.
+ */
+void uart_tx_stats(cbuf_stats_t * stats)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		circular_buf_stats(txbuf, stats);
+	}
+}
+
+/*!
+ * @brief Number of received bytes that arrived while the receive buffer was full.
+ * @return Count since uart_init(), wraps around at 65535.
+ *
+ * @par
+ * What happened to those bytes depends on RX_OVERFLOW_POLICY.
+ */
+uint16_t uart_rx_overruns(void)
+{
+	cbuf_stats_t stats;
+
+	uart_rx_stats(&stats);
+
+	return stats.overruns;
+}
+
 /*!
  * @brief Read one charcater from internal buffer
  * @param[out] data - Pointer to variable where data is to be stored.
@@ -207,5 +319,45 @@ void uart_flush(void)
 void uart_rx_complete_ISR(void)
 {
 	char incomingByte = receive();
+
+	//command frames go to their own queue, see frame.h
+	if (frame_receive_ISR((uint8_t)incomingByte))
+	{
+		return;
+	}
 	circular_buf_put(cbuf, incomingByte);
+}
+
+/*!
+ * @brief Called by interrupt handler every time the transmit register is empty.
+ *
+ * @par
+ * Sends the next queued byte. The interrupt is disabled once nothing is left to
+ * send and enabled again by uart_queue().
+ */
+void uart_tx_ready_ISR(void)
+{
+	char outgoingByte;
+
+	if (circular_buf_get(txbuf, &outgoingByte) == 0)
+	{
+		send(outgoingByte);
+	}
+	else
+	{
+		disable_tx_interrupt();
+	}
+}
+
+/*!
+ * @brief Called by interrupt handler once the last queued byte has been sent.
+ *
+ * @par
+ * The interrupt is only enabled in bus mode, where it releases the bus.
+ */
+void uart_tx_complete_ISR(void)
+{
+#if BUS_MODE
+	bus_tx_complete_ISR();
+#endif
 }
\ No newline at end of file
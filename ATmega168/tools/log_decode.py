@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""
+Decode the binary log frames sent by the ATmega168 (see include/log.h).
+
+The format strings never leave the MCU's flash, so they are read back from the
+ELF file that was flashed. Every LOG0()..LOG3() call site defines a symbol named
+"log_fmt_.<n>"; its address is the id sent in the frame.
+
+usage:
+    log_decode.py src/atmega.elf capture.bin
+    stty -F /dev/ttyUSB0 9600 raw && log_decode.py src/atmega.elf /dev/ttyUSB0
+
+Bytes that are not part of a log frame (e.g. door status messages) are skipped.
+"""
+
+import re
+import struct
+import sys
+
+LOG_SOF = 0xF5
+FMT_PREFIX = "log_fmt_"
+CONVERSION = re.compile(r"%[-+ 0#]*\d*(?:\.\d+)?(?:hh|h|l)?([diuxXc%])")
+
+SHT_SYMTAB = 2
+
+
+def read_format_strings(elf_path):
+    """Return {flash address: format string} for every log call site."""
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        raise ValueError("%s: not a 32-bit little endian ELF file" % elf_path)
+
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum = struct.unpack_from("<HH", elf, 0x2E)
+
+    sections = []
+    for i in range(shnum):
+        name, stype, flags, addr, offset, size, link, info, align, entsize = \
+            struct.unpack_from("<IIIIIIIIII", elf, shoff + i * shentsize)
+        sections.append({"type": stype, "addr": addr, "offset": offset,
+                         "size": size, "link": link, "entsize": entsize})
+
+    formats = {}
+    for symtab in (s for s in sections if s["type"] == SHT_SYMTAB):
+        strtab = sections[symtab["link"]]
+        for i in range(symtab["size"] // symtab["entsize"]):
+            name, value, size, info, other, shndx = struct.unpack_from(
+                "<IIIBBH", elf, symtab["offset"] + i * symtab["entsize"])
+            start = strtab["offset"] + name
+            sym = elf[start:elf.index(b"\0", start)].decode()
+            if not sym.startswith(FMT_PREFIX) or shndx >= len(sections):
+                continue
+            section = sections[shndx]
+            at = section["offset"] + value - section["addr"]
+            text = elf[at:elf.index(b"\0", at)].decode(errors="replace")
+            formats[value & 0xFFFF] = text
+
+    return formats
+
+
+def argument_count(fmt):
+    return sum(1 for c in CONVERSION.findall(fmt) if c != "%")
+
+
+def render(fmt, raw_args):
+    """Apply the format string, interpreting each raw 16-bit value per conversion."""
+    args = []
+    convs = [c for c in CONVERSION.findall(fmt) if c != "%"]
+    for conv, raw in zip(convs, raw_args):
+        if conv in "di":
+            args.append(raw - 0x10000 if raw & 0x8000 else raw)
+        elif conv == "c":
+            args.append(chr(raw & 0xFF))
+        else:
+            args.append(raw)
+    # python does not know the C length modifiers
+    return CONVERSION.sub(lambda m: m.group(0).replace("hh", "").replace("h", "")
+                          .replace("l", ""), fmt) % tuple(args)
+
+
+def decode(stream, formats):
+    """Yield decoded messages from an iterable of byte chunks."""
+    pending = bytearray()
+    for chunk in stream:
+        pending.extend(chunk)
+        while pending:
+            if pending[0] != LOG_SOF:
+                del pending[0]
+                continue
+            if len(pending) < 3:
+                break
+            log_id = pending[1] | (pending[2] << 8)
+            fmt = formats.get(log_id)
+            if fmt is None:
+                # SOF value inside other data, resynchronise on the next byte
+                del pending[0]
+                continue
+            argc = argument_count(fmt)
+            length = 3 + 2 * argc
+            if len(pending) < length:
+                break
+            raw = struct.unpack_from("<%dH" % argc, pending, 3)
+            del pending[:length]
+            yield render(fmt, raw)
+
+
+def chunks(f):
+    while True:
+        data = f.read1(4096) if hasattr(f, "read1") else f.read(4096)
+        if not data:
+            return
+        yield data
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 2
+
+    formats = read_format_strings(argv[1])
+    if not formats:
+        sys.stderr.write("%s: no log format strings found, was it built with "
+                         "LOG=1?\n" % argv[1])
+        return 1
+
+    source = sys.stdin.buffer if argv[2] == "-" else open(argv[2], "rb", buffering=0)
+    try:
+        for message in decode(chunks(source), formats):
+            print(message, flush=True)
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
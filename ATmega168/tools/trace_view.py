@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+Turn an ATmega168 trace dump (see include/trace.h) into a timeline and report ISR
+timing: duration, period jitter, nesting and time stolen from main loop phases.
+
+usage:
+    trace_view.py capture.bin
+    trace_view.py --request /dev/ttyUSB0     # send the dump request, then read
+
+Options:
+    --period-us N   nominal TIMER0_COMPA period used for jitter (default 1000)
+    --quiet         only print the summary, not the timeline
+
+The serial port must already be configured, e.g. "stty -F /dev/ttyUSB0 9600 raw".
+"""
+
+import os
+import statistics
+import sys
+
+TRACE_SOF = 0xF6
+TRACE_REQUEST = b"T"
+
+# keep in sync with enum trace_event in include/trace.h
+EVENTS = {
+    1: ("TIMER0_COMPA", "enter"), 2: ("TIMER0_COMPA", "exit"),
+    3: ("USART_RX", "enter"), 4: ("USART_RX", "exit"),
+    5: ("USART_UDRE", "enter"), 6: ("USART_UDRE", "exit"),
+    7: ("adc", "begin"), 8: ("adc", "end"),
+    9: ("fsm", "begin"), 10: ("fsm", "end"),
+    11: ("send", "begin"), 12: ("send", "end"),
+    13: ("idle", "begin"), 14: ("idle", "end"),
+}
+ISRS = ("TIMER0_COMPA", "USART_RX", "USART_UDRE")
+
+
+def find_dump(data):
+    """Return [(event, raw timestamp)] from the last valid dump in data."""
+    found = None
+    at = data.find(bytes([TRACE_SOF]))
+    while at != -1:
+        if at + 1 < len(data):
+            count = data[at + 1]
+            end = at + 2 + 3 * count
+            if end < len(data):
+                body = data[at + 1:end]
+                if sum(body) & 0xFF == data[end]:
+                    found = [(data[i], data[i + 1] | (data[i + 2] << 8))
+                             for i in range(at + 2, end, 3)]
+        at = data.find(bytes([TRACE_SOF]), at + 1)
+    return found
+
+
+def unwrap(records):
+    """Convert 16-bit wrapping timestamps to a monotonic microsecond time line.
+
+    The 1ms timer interrupt guarantees an event at least every 65ms while tracing,
+    so consecutive records are never more than one wrap apart.
+    """
+    timeline = []
+    offset = 0
+    previous = None
+    for event, stamp in records:
+        if previous is not None and stamp < previous:
+            offset += 0x10000
+        previous = stamp
+        timeline.append((offset + stamp, event))
+    if timeline:
+        start = timeline[0][0]
+        timeline = [(t - start, e) for t, e in timeline]
+    return timeline
+
+
+def describe(timeline, period_us, quiet):
+    open_isrs = []      # [(name, start)]
+    open_phase = None   # (name, start)
+    durations = {name: [] for name in ISRS}
+    entries = {name: [] for name in ISRS}
+    nested = {}
+    stolen = {}         # phase -> [count, us]
+
+    for t, event in timeline:
+        name, edge = EVENTS.get(event, ("unknown(%d)" % event, "?"))
+        depth = len(open_isrs) - (1 if edge == "exit" else 0)
+        depth += 1 if open_phase and name in ISRS else 0
+        if not quiet:
+            print("%10d  %s%s %s" % (t, "  " * max(depth, 0), name, edge))
+
+        if name in ISRS and edge == "enter":
+            if open_isrs:
+                key = "%s inside %s" % (name, open_isrs[-1][0])
+                nested[key] = nested.get(key, 0) + 1
+            open_isrs.append((name, t))
+            entries[name].append(t)
+        elif name in ISRS and edge == "exit":
+            if open_isrs and open_isrs[-1][0] == name:
+                _, start = open_isrs.pop()
+                durations[name].append(t - start)
+                if open_phase and not open_isrs:
+                    count_us = stolen.setdefault(open_phase[0], [0, 0])
+                    count_us[0] += 1
+                    count_us[1] += t - start
+        elif edge == "begin":
+            open_phase = (name, t)
+        elif edge == "end":
+            open_phase = None
+
+    print("\nISR          count   min us   avg us   max us")
+    for name in ISRS:
+        d = durations[name]
+        if d:
+            print("%-12s %5d %8d %8.1f %8d" % (name, len(d), min(d), statistics.mean(d), max(d)))
+
+    periods = [b - a for a, b in zip(entries["TIMER0_COMPA"], entries["TIMER0_COMPA"][1:])]
+    if periods:
+        jitter = [p - period_us for p in periods]
+        print("\nTIMER0_COMPA period: nominal %d us, min %d, max %d, jitter %+d/%+d us, "
+              "stdev %.1f us" % (period_us, min(periods), max(periods), min(jitter),
+                                 max(jitter), statistics.pstdev(periods)))
+
+    print("\nnesting:")
+    if nested:
+        for key, n in sorted(nested.items()):
+            print("  %-36s %d" % (key, n))
+    else:
+        print("  none (interrupts do not nest)")
+
+    print("\nISR time inside main loop phases:")
+    if stolen:
+        for phase, (n, us) in sorted(stolen.items()):
+            print("  %-10s %5d interrupts, %6d us" % (phase, n, us))
+    else:
+        print("  none")
+
+
+def read_capture(path, request):
+    if not request:
+        with open(path, "rb") as f:
+            return f.read()
+
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    try:
+        os.write(fd, TRACE_REQUEST)
+        data = bytearray()
+        while find_dump(data) is None:
+            chunk = os.read(fd, 256)
+            if not chunk:
+                break
+            data.extend(chunk)
+        return bytes(data)
+    finally:
+        os.close(fd)
+
+
+def main(argv):
+    args = argv[1:]
+    period_us, quiet, request = 1000, False, False
+    if "--quiet" in args:
+        args.remove("--quiet")
+        quiet = True
+    if "--request" in args:
+        args.remove("--request")
+        request = True
+    if "--period-us" in args:
+        i = args.index("--period-us")
+        period_us = int(args[i + 1])
+        del args[i:i + 2]
+    if len(args) != 1:
+        sys.stderr.write(__doc__)
+        return 2
+
+    records = find_dump(read_capture(args[0], request))
+    if records is None:
+        sys.stderr.write("%s: no complete trace dump found\n" % args[0])
+        return 1
+
+    describe(unwrap(records), period_us, quiet)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
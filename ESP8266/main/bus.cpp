@@ -0,0 +1,146 @@
+#include "bus.h"
+
+BusCoordinator::BusCoordinator(Stream& port, int dePin, uint8_t firstNode, uint8_t nodeCount)
+  : _port(port), _dePin(dePin), _first(firstNode),
+    _count(min<uint8_t>(nodeCount, BUS_MAX_NODES)), _onChange(nullptr), _reader(true),
+    _stats(), _current(0), _waiting(false), _sentMs(0), _cycleStartMs(0), _cyclePolls(0)
+{
+}
+
+void BusCoordinator::begin(ChangeHandler onChange)
+{
+  _onChange = onChange;
+
+  pinMode(_dePin, OUTPUT);
+  digitalWrite(_dePin, LOW);   // receive
+
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    _nodes[i].state  = '?';
+    _nodes[i].seq    = 0;
+    _nodes[i].adc    = 0;
+    _nodes[i].missed = BUS_NEVER_SEEN;
+  }
+
+  _current = _count - 1;       // the first next() starts a cycle at index 0
+  _cycleStartMs = millis();
+}
+
+void BusCoordinator::poll(uint8_t index)
+{
+  _current = index;
+  _stats.polls++;
+  _cyclePolls++;
+
+  // drive the bus only for the poll itself, flush() returns once it is sent
+  digitalWrite(_dePin, HIGH);
+  frame_write_to(_port, node_id(index), FRAME_CMD_POLL, nullptr, 0);
+  _port.flush();
+  digitalWrite(_dePin, LOW);
+
+  _waiting = true;
+  _sentMs = millis();
+}
+
+bool BusCoordinator::next(uint8_t& index)
+{
+  for (uint8_t tried = 0; tried < _count; tried++)
+  {
+    index = _current + 1;
+    if (index >= _count)
+    {
+      index = 0;
+      unsigned long now = millis();
+      _stats.cycles++;
+      // a pass that skipped every node says nothing about latency
+      if (_cyclePolls > 0)
+      {
+        _stats.lastCycleMs = now - _cycleStartMs;
+        _stats.maxCycleMs = max(_stats.maxCycleMs, _stats.lastCycleMs);
+      }
+      _cycleStartMs = now;
+      _cyclePolls = 0;
+    }
+    _current = index;
+
+    // offline nodes get a turn only every BUS_OFFLINE_EVERY cycles
+    if (online(index) || _nodes[index].missed == BUS_NEVER_SEEN ||
+        _stats.cycles % BUS_OFFLINE_EVERY == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BusCoordinator::reply()
+{
+  BusNode& node = _nodes[_current];
+  const uint8_t* status = _reader.payload();
+  bool seen = node.missed != BUS_NEVER_SEEN;
+
+  _stats.replies++;
+  node.missed = 0;
+  node.adc = status[2];
+
+  if (seen && status[1] != node.seq)
+  {
+    _stats.changes++;
+    if (_onChange)
+    {
+      _onChange(node_id(_current), (char)status[0]);
+    }
+  }
+  node.state = status[0];
+  node.seq = status[1];
+}
+
+void BusCoordinator::timeout()
+{
+  BusNode& node = _nodes[_current];
+
+  _stats.timeouts++;
+  if (node.missed == BUS_NEVER_SEEN)
+  {
+    node.missed = BUS_OFFLINE_AFTER;   // never answered, start out offline
+  }
+  else if (node.missed < BUS_OFFLINE_AFTER)
+  {
+    node.missed++;
+  }
+}
+
+void BusCoordinator::loop()
+{
+  if (_count == 0)
+  {
+    return;
+  }
+
+  while (_port.available())
+  {
+    if (_reader.feed(_port.read()) == FrameReader::COMPLETE && _waiting &&
+        _reader.address() == node_id(_current) && _reader.type() == FRAME_STATUS &&
+        _reader.length() == 3)
+    {
+      reply();
+      _waiting = false;
+    }
+  }
+
+  if (_waiting)
+  {
+    if (millis() - _sentMs < BUS_REPLY_TIMEOUT_MS)
+    {
+      return;
+    }
+    timeout();
+    _waiting = false;
+  }
+
+  uint8_t index;
+  if (next(index))
+  {
+    poll(index);
+  }
+}
@@ -0,0 +1,88 @@
+// RS-485 multi-drop bus coordinator.
+//
+// In bus mode the ESP8266 is wired to an RS-485 transceiver instead of a single
+// ATmega168, and many door nodes (ATmega168 built with "make BUS=1 NODE_ID=n",
+// see ATmega168/include/bus.h) share the bus. The coordinator is the only one
+// that talks unasked: it polls the nodes one at a time with FRAME_CMD_POLL and
+// waits up to BUS_REPLY_TIMEOUT_MS for the FRAME_STATUS reply before moving on,
+// so two nodes never transmit at once. The change handler is called from loop()
+// and must not block; queue slow work such as notifications for later.
+//
+// Each node takes 4 bytes in the table. A node that misses BUS_OFFLINE_AFTER
+// polls in a row is offline and only polled every BUS_OFFLINE_EVERY cycles, so
+// dead nodes do not slow down the others. The first reply from a node sets its
+// baseline; after that the change handler is called only when its state sequence
+// moves, i.e. on real changes (including an open and close between two polls).
+//
+// tools/bus_sim.py builds this coordinator for the host and runs it against many
+// virtual nodes to show how the polling cycle grows with the node count.
+#ifndef BUS_H
+#define BUS_H
+
+#include <Arduino.h>
+#include "frame.h"
+
+#define BUS_MAX_NODES         64
+#define BUS_REPLY_TIMEOUT_MS  25    // poll, node turnaround and reply: about 17 ms at 9600 baud
+#define BUS_OFFLINE_AFTER     3     // missed polls in a row
+#define BUS_OFFLINE_EVERY     8     // cycles between polls of an offline node
+#define BUS_BROADCAST         0x00
+
+struct BusNode {
+  uint8_t state;      // 'o', 'c', or '?' before the first change
+  uint8_t seq;        // state changes reported by the node
+  uint8_t adc;        // last reading
+  uint8_t missed;     // polls missed in a row, BUS_NEVER_SEEN until the first reply
+};
+
+#define BUS_NEVER_SEEN 0xFF
+
+struct BusStats {
+  uint32_t polls;
+  uint32_t replies;
+  uint32_t timeouts;
+  uint32_t changes;         // change handler calls
+  uint32_t cycles;          // complete passes over the table
+  uint32_t lastCycleMs;     // time for the last pass, the worst case detection delay
+  uint32_t maxCycleMs;
+};
+
+class BusCoordinator {
+public:
+  typedef void (*ChangeHandler)(uint8_t node, char state);
+
+  // nodes firstNode .. firstNode + nodeCount - 1, dePin drives DE and /RE
+  BusCoordinator(Stream& port, int dePin, uint8_t firstNode, uint8_t nodeCount);
+
+  void begin(ChangeHandler onChange);
+  // non-blocking, call as often as possible
+  void loop();
+
+  uint8_t count() const { return _count; }
+  const BusNode& node(uint8_t index) const { return _nodes[index]; }
+  uint8_t node_id(uint8_t index) const { return _first + index; }
+  bool online(uint8_t index) const { return _nodes[index].missed < BUS_OFFLINE_AFTER; }
+  const BusStats& stats() const { return _stats; }
+
+private:
+  void poll(uint8_t index);
+  bool next(uint8_t& index);
+  void reply();
+  void timeout();
+
+  Stream&       _port;
+  int           _dePin;
+  uint8_t       _first;
+  uint8_t       _count;
+  ChangeHandler _onChange;
+  FrameReader   _reader;
+  BusNode       _nodes[BUS_MAX_NODES];
+  BusStats      _stats;
+  uint8_t       _current;
+  bool          _waiting;
+  unsigned long _sentMs;
+  unsigned long _cycleStartMs;
+  uint16_t      _cyclePolls;
+};
+
+#endif
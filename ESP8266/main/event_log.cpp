@@ -0,0 +1,250 @@
+#include <LittleFS.h>
+#include <time.h>
+#include "event_log.h"
+
+#define EVENT_TIME_VALID 1600000000UL   // time() above this comes from NTP
+
+uint32_t event_log_now()
+{
+  time_t now = time(nullptr);
+  return now > (time_t)EVENT_TIME_VALID ? (uint32_t)now : millis() / 1000;
+}
+
+static bool read_varint(File& file, uint32_t& value)
+{
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    int byte = file.read();
+    if (byte < 0)
+    {
+      return false;
+    }
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// next record, time carried over from the previous one; false at the end or on a
+// truncated record (e.g. power lost during a write)
+static bool read_record(File& file, uint32_t& time, LoggedEvent& event)
+{
+  uint32_t value;
+  int code;
+  if (!read_varint(file, value) || (code = file.read()) < 0)
+  {
+    return false;
+  }
+
+  event.code = (char)code;
+  event.node = 0;
+  if (value & 1)
+  {
+    int node = file.read();
+    if (node < 0)
+    {
+      return false;
+    }
+    event.node = node;
+  }
+
+  time = (event.code == EVENT_SYNC) ? (value >> 1) : time + (value >> 1);
+  event.time = time;
+  return true;
+}
+
+bool EventLog::begin()
+{
+  if (!LittleFS.begin())
+  {
+    return false;
+  }
+
+  uint32_t events = 0;
+  File file = LittleFS.open(EVENT_LOG_PATH, "r");
+  if (file)
+  {
+    uint32_t time = 0;
+    LoggedEvent event;
+    while (read_record(file, time, event))
+    {
+      if (event.code != EVENT_SYNC)
+      {
+        index(event);
+        events++;
+      }
+    }
+    _lastTime = time;
+    _stats.bytes = file.size();
+    file.close();
+  }
+
+  _complete = events <= EVENT_INDEX_SIZE && !LittleFS.exists(EVENT_LOG_OLD_PATH);
+  return true;
+}
+
+bool EventLog::write(uint32_t value, char code, uint8_t node)
+{
+  uint8_t record[7];
+  size_t length = 0;
+  bool hasNode = node != 0;
+  // epoch seconds stay below 2^31 until 2038, so the shift loses nothing
+  uint32_t encoded = (value << 1) | (hasNode ? 1 : 0);
+
+  do
+  {
+    uint8_t byte = encoded & 0x7F;
+    encoded >>= 7;
+    record[length++] = byte | (encoded ? 0x80 : 0);
+  } while (encoded);
+  record[length++] = code;
+  if (hasNode)
+  {
+    record[length++] = node;
+  }
+
+  File file = LittleFS.open(EVENT_LOG_PATH, "a");
+  if (!file)
+  {
+    return false;
+  }
+  bool ok = file.write(record, length) == length;
+  file.close();
+
+  if (ok)
+  {
+    _stats.bytes += length;
+  }
+  return ok;
+}
+
+bool EventLog::append(char code, uint8_t node)
+{
+  uint32_t now = event_log_now();
+
+  if (_stats.bytes >= EVENT_LOG_MAX_BYTES)
+  {
+    LittleFS.remove(EVENT_LOG_OLD_PATH);
+    LittleFS.rename(EVENT_LOG_PATH, EVENT_LOG_OLD_PATH);
+    _stats.bytes = 0;
+  }
+
+  // times only go forward within a file, which keeps the deltas unsigned
+  if (_stats.bytes == 0 || now < _lastTime)
+  {
+    if (!write(now, EVENT_SYNC, 0))
+    {
+      return false;
+    }
+    _lastTime = now;
+  }
+
+  if (!write(now - _lastTime, code, node))
+  {
+    return false;
+  }
+  _lastTime = now;
+
+  LoggedEvent event = {now, code, node};
+  index(event);
+  _stats.appended++;
+  return true;
+}
+
+void EventLog::index(const LoggedEvent& event)
+{
+  if (_size == EVENT_INDEX_SIZE)
+  {
+    _head = (_head + 1) % EVENT_INDEX_SIZE;
+    _complete = false;
+  }
+  else
+  {
+    _size++;
+  }
+  _index[(_head + _size - 1) % EVENT_INDEX_SIZE] = event;
+}
+
+const LoggedEvent* EventLog::last() const
+{
+  return _size ? &_index[(_head + _size - 1) % EVENT_INDEX_SIZE] : nullptr;
+}
+
+size_t EventLog::scan(const char* path, uint32_t from, uint32_t to, LoggedEvent* keep,
+                      size_t limit, size_t& matches)
+{
+  File file = LittleFS.open(path, "r");
+  if (!file)
+  {
+    return matches;
+  }
+
+  uint32_t time = 0;
+  LoggedEvent event;
+  while (read_record(file, time, event))
+  {
+    if (event.code != EVENT_SYNC && event.time >= from && event.time <= to)
+    {
+      // keep only the newest limit matches
+      keep[matches % limit] = event;
+      matches++;
+    }
+  }
+  file.close();
+  return matches;
+}
+
+size_t EventLog::query(uint32_t from, uint32_t to, size_t limit, Visitor visit, void* context)
+{
+  if (limit == 0)
+  {
+    return 0;
+  }
+
+  // the index holds the newest events, so it has the answer if it reaches back far
+  // enough or already holds limit matches
+  size_t first = _size;
+  size_t found = 0;
+  for (size_t i = _size; i-- > 0 && found < limit;)
+  {
+    const LoggedEvent& event = _index[(_head + i) % EVENT_INDEX_SIZE];
+    if (event.time >= from && event.time <= to)
+    {
+      first = i;
+      found++;
+    }
+  }
+
+  if (_complete || found == limit || (_size > 0 && from >= _index[_head].time))
+  {
+    _stats.indexQueries++;
+    for (size_t i = first; i < _size; i++)
+    {
+      const LoggedEvent& event = _index[(_head + i) % EVENT_INDEX_SIZE];
+      if (event.time >= from && event.time <= to)
+      {
+        visit(event, context);
+      }
+    }
+    return found;
+  }
+
+  _stats.fileQueries++;
+
+  std::unique_ptr<LoggedEvent[]> keep(new LoggedEvent[limit]);
+  size_t matches = 0;
+  scan(EVENT_LOG_OLD_PATH, from, to, keep.get(), limit, matches);
+  scan(EVENT_LOG_PATH, from, to, keep.get(), limit, matches);
+
+  found = min(matches, limit);
+  size_t start = matches > limit ? matches % limit : 0;
+  for (size_t i = 0; i < found; i++)
+  {
+    visit(keep[(start + i) % limit], context);
+  }
+  return found;
+}
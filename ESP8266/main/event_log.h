@@ -0,0 +1,75 @@
+// On-device event history.
+//
+// Door events are appended to a file on LittleFS so the state history survives
+// resets and can be read without the cloud. Each record is
+//
+//   varint(value << 1 | hasNode)  code  [node]
+//
+// where value is the number of seconds since the previous record, except for
+// EVENT_SYNC records, whose value is the absolute time. A sync record starts every
+// file and is written again whenever the clock goes backwards (e.g. NTP not synced
+// yet after a reset), so a typical event takes 2-3 bytes. When the file reaches
+// EVENT_LOG_MAX_BYTES it becomes EVENT_LOG_OLD_PATH, replacing the previous one.
+//
+// The newest EVENT_INDEX_SIZE events are also kept in RAM. Queries for recent events
+// never touch the flash; only ones reaching further back scan the files.
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <Arduino.h>
+
+#define EVENT_LOG_PATH       "/events.log"
+#define EVENT_LOG_OLD_PATH   "/events.old"
+#define EVENT_LOG_MAX_BYTES  32768
+#define EVENT_INDEX_SIZE     64
+#define EVENT_SYNC           '='   // record holding an absolute time
+
+struct LoggedEvent {
+  uint32_t time;    // seconds, UTC epoch once NTP has synced, uptime before that
+  char     code;    // 'o', 'c'
+  uint8_t  node;    // bus node, 0 without a bus
+};
+
+struct EventLogStats {
+  uint32_t appended;
+  uint32_t bytes;           // size of the current file
+  uint32_t indexQueries;    // answered from RAM
+  uint32_t fileQueries;     // had to scan the flash
+};
+
+class EventLog {
+public:
+  typedef void (*Visitor)(const LoggedEvent& event, void* context);
+
+  EventLog() : _head(0), _size(0), _lastTime(0), _complete(true), _stats() {}
+
+  // mount LittleFS and rebuild the index from the current file
+  bool begin();
+  bool append(char code, uint8_t node = 0);
+
+  // the newest limit events with from <= time <= to, passed to visit oldest first;
+  // returns how many were visited
+  size_t query(uint32_t from, uint32_t to, size_t limit, Visitor visit, void* context);
+
+  // newest event, nullptr if none
+  const LoggedEvent* last() const;
+  const EventLogStats& stats() const { return _stats; }
+
+private:
+  void index(const LoggedEvent& event);
+  size_t scan(const char* path, uint32_t from, uint32_t to, LoggedEvent* keep, size_t limit,
+              size_t& matches);
+  bool write(uint32_t value, char code, uint8_t node);
+
+  LoggedEvent _index[EVENT_INDEX_SIZE];
+  uint8_t     _head;        // oldest entry
+  uint8_t     _size;
+  uint32_t    _lastTime;
+  bool        _complete;    // the index holds every logged event
+  EventLogStats _stats;
+};
+
+// current time for the log, seconds
+uint32_t event_log_now();
+
+#endif
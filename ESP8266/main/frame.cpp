@@ -0,0 +1,180 @@
+#include "frame.h"
+
+FrameReader::Result FrameReader::feed(uint8_t byte)
+{
+  unsigned long now = millis();
+  if (_state != IDLE && now - _lastMs > FRAME_TIMEOUT_MS)
+  {
+    _state = IDLE;
+    _errors++;
+  }
+  _lastMs = now;
+
+  switch (_state)
+  {
+    case IDLE:
+      if (byte != FRAME_SOF)
+      {
+        return NONE;
+      }
+      _checksum = 0;
+      _state = _addressed ? ADDRESS : TYPE;
+      return PENDING;
+
+    case ADDRESS:
+      _address = byte;
+      _checksum += byte;
+      _state = TYPE;
+      return PENDING;
+
+    case TYPE:
+      _type = byte;
+      _checksum += byte;
+      _state = LENGTH;
+      return PENDING;
+
+    case LENGTH:
+      if (byte > FRAME_MAX_PAYLOAD)
+      {
+        _state = IDLE;
+        _errors++;
+        return PENDING;
+      }
+      _length = byte;
+      _received = 0;
+      _checksum += byte;
+      _state = _length ? PAYLOAD : CHECKSUM;
+      return PENDING;
+
+    case PAYLOAD:
+      _payload[_received++] = byte;
+      _checksum += byte;
+      if (_received == _length)
+      {
+        _state = CHECKSUM;
+      }
+      return PENDING;
+
+    case CHECKSUM:
+      _state = IDLE;
+      if (byte != _checksum)
+      {
+        _errors++;
+        return PENDING;
+      }
+      _frames++;
+      return COMPLETE;
+  }
+  return NONE;
+}
+
+static bool write_frame(Stream& stream, bool addressed, uint8_t address, uint8_t type,
+                        const uint8_t* payload, uint8_t length)
+{
+  uint8_t frame[FRAME_MAX_PAYLOAD + 5];
+  uint8_t checksum = type + length;
+  size_t size = 0;
+
+  if (length > FRAME_MAX_PAYLOAD)
+  {
+    return false;
+  }
+
+  frame[size++] = FRAME_SOF;
+  if (addressed)
+  {
+    frame[size++] = address;
+    checksum += address;
+  }
+  frame[size++] = type;
+  frame[size++] = length;
+  for (uint8_t i = 0; i < length; i++)
+  {
+    frame[size++] = payload[i];
+    checksum += payload[i];
+  }
+  frame[size++] = checksum;
+
+  return stream.write(frame, size) == size;
+}
+
+bool frame_write(Stream& stream, uint8_t type, const uint8_t* payload, uint8_t length)
+{
+  return write_frame(stream, false, 0, type, payload, length);
+}
+
+bool frame_write_to(Stream& stream, uint8_t address, uint8_t type, const uint8_t* payload,
+                    uint8_t length)
+{
+  return write_frame(stream, true, address, type, payload, length);
+}
+
+bool CommandSender::send(uint8_t type, const uint8_t* payload, uint8_t length)
+{
+  if (_count == FRAME_CMD_PENDING || length > FRAME_CMD_PAYLOAD)
+  {
+    return false;
+  }
+
+  Command& command = _commands[_count++];
+  command.type = type;
+  command.length = length;
+  if (length)
+  {
+    memcpy(command.payload, payload, length);
+  }
+  command.tries = 1;
+  command.sentMs = millis();
+  _stats.sent++;
+  frame_write(_stream, type, payload, length);
+  return true;
+}
+
+void CommandSender::remove(int i)
+{
+  for (; i + 1 < _count; i++)
+  {
+    _commands[i] = _commands[i + 1];
+  }
+  _count--;
+}
+
+void CommandSender::acked(uint8_t type, uint8_t status)
+{
+  for (int i = 0; i < _count; i++)
+  {
+    if (_commands[i].type == type)
+    {
+      _stats.acked++;
+      if (status != FRAME_OK)
+      {
+        _stats.rejected++;
+      }
+      remove(i);
+      return;
+    }
+  }
+}
+
+void CommandSender::loop()
+{
+  for (int i = 0; i < _count; i++)
+  {
+    Command& command = _commands[i];
+    if (millis() - command.sentMs < FRAME_ACK_TIMEOUT_MS)
+    {
+      continue;
+    }
+    if (command.tries > FRAME_CMD_RETRIES)
+    {
+      _stats.failed++;
+      remove(i--);
+      continue;
+    }
+
+    command.tries++;
+    command.sentMs = millis();
+    _stats.retries++;
+    frame_write(_stream, command.type, command.payload, command.length);
+  }
+}
@@ -0,0 +1,135 @@
+// Typed binary frames to and from the ATmega168 (see ATmega168/include/frame.h):
+//
+//   FRAME_SOF | type | length | payload | checksum
+//
+// checksum is the 8-bit sum of type, length and payload. Frames share the serial
+// line with the single byte status messages, FRAME_SOF never starts one of those.
+// On the RS-485 bus (see bus.h) an address byte follows FRAME_SOF and is included
+// in the checksum.
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <Arduino.h>
+
+#define FRAME_SOF          0xF7
+#define FRAME_MAX_PAYLOAD  16
+#define FRAME_TIMEOUT_MS   100    // a frame is sent in one go, give up on a partial one
+#define FRAME_CMD_PAYLOAD  4      // largest command payload the ATmega168 accepts
+#define FRAME_CMD_PENDING  4      // commands waiting for their FRAME_ACK
+#define FRAME_ACK_TIMEOUT_MS 500  // command sent until repeated
+#define FRAME_CMD_RETRIES  3
+
+enum FrameType : uint8_t {
+  // ATmega168 -> ESP8266
+  FRAME_TELEMETRY       = 0x01,
+  FRAME_ACK             = 0x02,   // command type, FrameStatus
+  FRAME_STATUS          = 0x03,   // bus poll reply: status, sequence, adc
+  FRAME_LINK_STATS      = 0x04,   // deep sleep delivery counters, 5 x 2 bytes (link.h)
+  // ESP8266 -> ATmega168, at most 4 payload bytes
+  FRAME_CMD_ACK         = 0x10,   // type of the frame acknowledged
+  FRAME_CMD_SET_PARAM   = 0x11,   // FrameParam, value (2 bytes)
+  FRAME_CMD_SAMPLE_RATE = 0x12,   // fast period ms (2 bytes), slow period ms (2 bytes)
+  FRAME_CMD_TELEMETRY   = 0x13,   // send a telemetry record now
+  FRAME_CMD_POLL        = 0x14,   // bus only, answered with FRAME_STATUS
+};
+
+enum FrameParam : uint8_t {
+  PARAM_TELEMETRY_PERIOD_S = 0x01,
+  PARAM_OPEN_REPEAT_MS     = 0x02,
+};
+
+enum FrameStatus : uint8_t {
+  FRAME_OK          = 0x00,
+  FRAME_BAD_COMMAND = 0x01,
+  FRAME_BAD_VALUE   = 0x02,
+};
+
+// write one frame, false if the stream did not take all of it
+bool frame_write(Stream& stream, uint8_t type, const uint8_t* payload, uint8_t length);
+// same, with the address byte used on the bus
+bool frame_write_to(Stream& stream, uint8_t address, uint8_t type, const uint8_t* payload,
+                    uint8_t length);
+
+// Commands to the ATmega168, repeated until it answers with FRAME_ACK. The
+// ATmega168 drops an answer that does not fit in its transmit buffer, and a
+// command frame can be lost to a framing error. Answers come in command order, so
+// an ACK is matched to the oldest outstanding command of its type.
+struct CommandStats {
+  uint32_t sent;
+  uint32_t acked;
+  uint32_t rejected;    // answered with a FrameStatus other than FRAME_OK
+  uint32_t retries;
+  uint32_t failed;      // never answered, given up after FRAME_CMD_RETRIES
+};
+
+class CommandSender {
+public:
+  explicit CommandSender(Stream& stream) : _stream(stream), _count(0), _stats() {}
+
+  // false if FRAME_CMD_PENDING commands are already waiting
+  bool send(uint8_t type, const uint8_t* payload, uint8_t length);
+  // FRAME_ACK payload received from the ATmega168
+  void acked(uint8_t type, uint8_t status);
+  // repeat commands whose answer is overdue, call from loop()
+  void loop();
+
+  int pending() const { return _count; }
+  const CommandStats& stats() const { return _stats; }
+
+private:
+  struct Command {
+    uint8_t       type;
+    uint8_t       length;
+    uint8_t       payload[FRAME_CMD_PAYLOAD];
+    uint8_t       tries;
+    unsigned long sentMs;
+  };
+
+  void remove(int i);
+
+  Stream&      _stream;
+  Command      _commands[FRAME_CMD_PENDING];
+  int          _count;
+  CommandStats _stats;
+};
+
+class FrameReader {
+public:
+  enum Result {
+    NONE,       // not part of a frame, handle the byte as a status message
+    PENDING,    // consumed, frame not complete yet
+    COMPLETE,   // consumed, a valid frame is available until the next feed()
+  };
+
+  // addressed: frames carry an address byte, as on the bus
+  explicit FrameReader(bool addressed = false)
+    : _addressed(addressed), _state(IDLE), _address(0), _length(0), _received(0),
+      _checksum(0), _lastMs(0), _frames(0), _errors(0) {}
+
+  Result feed(uint8_t byte);
+
+  uint8_t address() const { return _address; }
+  uint8_t type() const { return _type; }
+  uint8_t length() const { return _length; }
+  const uint8_t* payload() const { return _payload; }
+
+  uint32_t frames() const { return _frames; }
+  uint32_t errors() const { return _errors; }   // bad checksum, length or timeout
+
+private:
+  enum State { IDLE, ADDRESS, TYPE, LENGTH, PAYLOAD, CHECKSUM };
+
+  bool          _addressed;
+  State         _state;
+  uint8_t       _address;
+  uint8_t       _type;
+  uint8_t       _length;
+  uint8_t       _received;
+  uint8_t       _checksum;
+  uint8_t       _payload[FRAME_MAX_PAYLOAD];
+  unsigned long _lastMs;
+  uint32_t      _frames;
+  uint32_t      _errors;
+};
+
+#endif
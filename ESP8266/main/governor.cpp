@@ -0,0 +1,104 @@
+#include <ESP8266WiFi.h>
+#include "governor.h"
+
+extern "C" {
+#include "user_interface.h"
+#include "gpio.h"
+}
+
+void CpuGovernor::begin()
+{
+  system_update_cpu_freq(SYS_CPU_80MHZ);
+  _since = millis();
+  _mode = CPU_ACTIVE;
+}
+
+void CpuGovernor::enter(CpuMode mode)
+{
+  unsigned long now = millis();
+  _stats.ms[_mode] += now - _since;
+  _since = now;
+  _mode = mode;
+}
+
+void CpuGovernor::boost()
+{
+  if (!GOVERNOR_BOOST)
+  {
+    return;
+  }
+
+  if (_depth++ == 0)
+  {
+    enter(CPU_BOOST);
+    _stats.boosts++;
+    system_update_cpu_freq(SYS_CPU_160MHZ);
+  }
+}
+
+void CpuGovernor::relax()
+{
+  if (_depth > 0 && --_depth == 0)
+  {
+    system_update_cpu_freq(SYS_CPU_80MHZ);
+    enter(CPU_ACTIVE);
+  }
+}
+
+void CpuGovernor::idle()
+{
+  if (_depth > 0)
+  {
+    return;
+  }
+
+#if GOVERNOR_LIGHT_SLEEP
+  light_sleep(millis() - _lastRxMs >= GOVERNOR_AWAKE_MS);
+#endif
+  enter(CPU_IDLE);
+  delay(GOVERNOR_IDLE_MS);
+  enter(CPU_ACTIVE);
+}
+
+void CpuGovernor::received()
+{
+  _lastRxMs = millis();
+#if GOVERNOR_LIGHT_SLEEP
+  light_sleep(false);
+#endif
+}
+
+void CpuGovernor::light_sleep(bool enable)
+{
+  if (enable == _lightSleep)
+  {
+    return;
+  }
+
+  _lightSleep = enable;
+  if (enable)
+  {
+    // RX is GPIO3, a start bit wakes the CPU
+    wifi_enable_gpio_wakeup(GPIO_ID_PIN(3), GPIO_PIN_INTR_LOLEVEL);
+    WiFi.setSleepMode(WIFI_LIGHT_SLEEP);
+  }
+  else
+  {
+    WiFi.setSleepMode(WIFI_MODEM_SLEEP);
+  }
+}
+
+GovernorStats CpuGovernor::stats() const
+{
+  GovernorStats stats = _stats;
+  stats.ms[_mode] += millis() - _since;
+  return stats;
+}
+
+String CpuGovernor::summary() const
+{
+  GovernorStats now = stats();
+  return "cpu 80 MHz " + String(now.ms[CPU_ACTIVE] / 1000) + " s, 160 MHz " +
+         String(now.ms[CPU_BOOST] / 1000) + " s in " + String(now.boosts) + " bursts, idle " +
+         String(now.ms[CPU_IDLE] / 1000) + " s";
+}
@@ -0,0 +1,81 @@
+// CPU frequency governor.
+//
+// The TLS handshake (WebhookNotifier) is CPU bound, while most of the time the
+// ESP8266 only waits for a byte from the ATmega168. CpuBoost raises the clock to
+// 160 MHz for the duration of a network burst and drops back to 80 MHz after.
+// When nothing is going on, idle() waits at 80 MHz with delay(), which lets the
+// SDK put the CPU to sleep between WiFi beacons.
+//
+// With GOVERNOR_LIGHT_SLEEP the idle wait uses automatic light sleep instead of
+// modem sleep, woken by the UART RX line going low. The byte that wakes the CPU
+// can be lost, so light sleep only starts GOVERNOR_AWAKE_MS after the last byte
+// received: the ATmega168's near-threshold hint (see notifier.h) usually wakes
+// it before an event. An event that skips the hint band can still be lost,
+// which is why light sleep is off by default.
+//
+// Time spent in each mode is accumulated, see stats(). WebhookNotifier reports
+// TLS handshake latency per clock frequency in its TlsInfo.
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <Arduino.h>
+
+#define GOVERNOR_BOOST       1      // 0 stays at 80 MHz, to compare handshake times
+#define GOVERNOR_LIGHT_SLEEP 0
+#define GOVERNOR_IDLE_MS     10     // one idle wait; the 128 byte UART FIFO covers it
+#define GOVERNOR_AWAKE_MS    20000  // no light sleep this long after a received byte
+
+enum CpuMode {
+  CPU_ACTIVE,   // 80 MHz, running
+  CPU_BOOST,    // 160 MHz, network and crypto bursts
+  CPU_IDLE,     // 80 MHz, in idle(), sleep allowed
+  CPU_MODES
+};
+
+struct GovernorStats {
+  uint32_t ms[CPU_MODES];
+  uint32_t boosts;
+};
+
+class CpuGovernor {
+public:
+  CpuGovernor()
+    : _mode(CPU_ACTIVE), _since(0), _depth(0), _lastRxMs(0), _lightSleep(false), _stats() {}
+
+  void begin();
+  // nesting is allowed, the clock drops once the outermost burst ends
+  void boost();
+  void relax();
+  // nothing to do, wait GOVERNOR_IDLE_MS at low power
+  void idle();
+  // call when a byte arrives, keeps light sleep off for GOVERNOR_AWAKE_MS
+  void received();
+
+  CpuMode mode() const { return _mode; }
+  // totals including the time spent in the current mode so far
+  GovernorStats stats() const;
+  String summary() const;
+
+private:
+  void enter(CpuMode mode);
+  void light_sleep(bool enable);
+
+  CpuMode       _mode;
+  unsigned long _since;
+  uint8_t       _depth;
+  unsigned long _lastRxMs;
+  bool          _lightSleep;
+  GovernorStats _stats;
+};
+
+// 160 MHz for the lifetime of the object
+class CpuBoost {
+public:
+  explicit CpuBoost(CpuGovernor& governor) : _governor(governor) { _governor.boost(); }
+  ~CpuBoost() { _governor.relax(); }
+
+private:
+  CpuGovernor& _governor;
+};
+
+#endif
@@ -1,70 +1,575 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266WiFiMulti.h>
-#include <ESP8266HTTPClient.h>
-#include <WiFiClientSecureBearSSL.h>
 #include "secrets.h"
+#include "bus.h"
+#include "event_log.h"
+#include "frame.h"
+#include "governor.h"
+#include "notifier.h"
+#include "status_server.h"
+#include "telemetry.h"
+#include "wifi_cache.h"
+
+// ================= configuration =================
+// 1: stay in deep sleep until woken by the ATmega168 over RST (build the ATmega168
+//    with ESP_DEEP_SLEEP=1, see ATmega168/include/link.h for the handshake)
+// 0: stay connected and wait for status messages on Serial
+#define DEEP_SLEEP_MODE 0
+
+// 1: Serial is an RS-485 bus with many ATmega168 nodes (built with BUS=1), polled
+//    by this ESP8266, see bus.h. Not combined with DEEP_SLEEP_MODE.
+#define BUS_COORDINATOR   0
+#define BUS_DE_PIN        D1    // transceiver DE and /RE
+#define BUS_FIRST_NODE    1
+#define BUS_NODE_COUNT    8
+
+#define LINK_READY        'R'
+#define LINK_HINT         'h'   // door reading near the threshold, an event may follow
+#define LINK_ACK          'A'
+#define EVENT_TIMEOUT_MS  1000  // READY sent until the first event
+#define LINK_LINGER_MS    200   // ACK sent until going back to sleep
+#define WIFI_TIMEOUT_MS   10000
+#define POST_RETRIES      3
+#define RTC_WAKE_STATS    0     // RTC user memory block holding WakeStats
+#define WAKE_REPORT_POSTS 24    // wake statistics sent to the health sinks this often
+#define WAKE_RETRY_WAKES  4     // ATmega168 LINK_RETRIES + 1, wakes spent on one event
+#define TELEMETRY_WINDOW_MS 3600000  // one health summary per window, 0 to disable
+
+// ATmega168 settings pushed over the control channel at boot, 0 keeps its default
+#define ATMEGA_TELEMETRY_PERIOD_S 0
+#define ATMEGA_OPEN_REPEAT_MS     0
+#define ATMEGA_SAMPLE_FAST_MS     0    // both fast and slow must be set
+#define ATMEGA_SAMPLE_SLOW_MS     0
+
+// event history on LittleFS and LAN endpoint (see status_server.h), not in deep sleep mode
+#define STATUS_HTTP_PORT  80    // 0 disables the endpoint
+#define NTP_SERVER        "pool.ntp.org"
+#define STATUS_BUS_REFRESH_MS 1000  // bus mode, /status rebuilt at most this often
+
+// notifier backends, set to 0 to disable. See notifier.h and tools/standin_servers.py
+#define NOTIFY_WEBHOOK    1     // SECRET_WEBHOOK, may be http:// for a local stand-in
+#define NOTIFY_MQTT       0
+#define NOTIFY_UDP        0
+#define NOTIFY_TCP        0
+#define MQTT_HOST         "192.168.1.10"
+#define MQTT_PORT         1883
+#define MQTT_CLIENT_ID    "door-status-notifier"
+#define MQTT_TOPIC        "door/status"
+#define COLLECTOR_HOST    "192.168.1.10"  // LAN collector for UDP and TCP
+#define COLLECTOR_UDP     5005
+#define COLLECTOR_TCP     5006
+
+// health summary sinks (TELEMETRY_WINDOW_MS), kept apart from the door state backends
+#define HEALTH_MQTT       0     // MQTT_HEALTH_TOPIC on MQTT_HOST, not retained
+#define HEALTH_UDP        0     // COLLECTOR_HOST:COLLECTOR_HEALTH_UDP
+#define MQTT_HEALTH_TOPIC "door/health"
+#define COLLECTOR_HEALTH_UDP 5007
+// ================ end configuration ===============
 
 // ================= global variables =================
 String messageClosed = "Door is closed";
 String messageOpen   = "Door is OPEN!";
 
-const char* url = SECRET_WEBHOOK;
 char data;
-int code;
 
 ESP8266WiFiMulti WiFiMulti;
-HTTPClient https;
-std::unique_ptr<BearSSL::WiFiClientSecure>client(new BearSSL::WiFiClientSecure);
+NotifierGroup notifiers;
+NotifierGroup healthSinks;
+FrameReader frames;
+CommandSender commands(Serial);
+#if BUS_COORDINATOR
+BusCoordinator bus(Serial, BUS_DE_PIN, BUS_FIRST_NODE, BUS_NODE_COUNT);
+#endif
+TelemetryWindow telemetry(TELEMETRY_WINDOW_MS);
+EventLog eventLog;
+CpuGovernor governor;
+StatusServer statusServer(STATUS_HTTP_PORT, eventLog);
+
+#if NOTIFY_WEBHOOK
+WebhookNotifier webhook(SECRET_WEBHOOK, fingerprint);
+#endif
+#if NOTIFY_MQTT
+MqttNotifier mqtt(MQTT_HOST, MQTT_PORT, MQTT_CLIENT_ID, MQTT_TOPIC);
+#endif
+#if NOTIFY_UDP
+UdpNotifier udp(COLLECTOR_HOST, COLLECTOR_UDP);
+#endif
+#if NOTIFY_TCP
+TcpNotifier tcp(COLLECTOR_HOST, COLLECTOR_TCP);
+#endif
+#if HEALTH_MQTT
+// its own connection, a second one with the same client id would close the first
+MqttNotifier healthMqtt(MQTT_HOST, MQTT_PORT, MQTT_CLIENT_ID "-health", MQTT_HEALTH_TOPIC, false);
+#endif
+#if HEALTH_UDP
+UdpNotifier healthUdp(COLLECTOR_HOST, COLLECTOR_HEALTH_UDP);
+#endif
+
+// kept in RTC user memory, survives deep sleep but not power loss
+struct WakeStats {
+  uint32_t magic;
+  uint32_t wakes;
+  uint32_t posts;
+  uint32_t failures;
+  uint32_t lastMs;   // boot until the last successful POST
+  uint32_t maxMs;
+  uint32_t totalMs;  // sum over all successful POSTs, for the average
+  uint32_t reportedPosts;
+  // FRAME_LINK_STATS, the ATmega168's side: wake line until ACK
+  uint16_t linkDelivered;
+  uint16_t linkDropped;
+  uint16_t linkRetries;
+  uint16_t linkLastMs;
+  uint16_t linkMaxMs;
+  // an event not every backend got, the ATmega168 sends it again on the next wake
+  char     retryEvent;
+  uint8_t  retryDelivered;   // NotifierGroup::delivered(), skipped on the retry
+  uint32_t retryWake;
+};
+// RTC user memory is addressed in 4 byte blocks
+static_assert(sizeof(WakeStats) <= (RTC_WIFI_CACHE - RTC_WAKE_STATS) * 4,
+              "WakeStats overlaps the WiFi cache");
+const uint32_t WAKE_STATS_MAGIC = 0x57414B32;
 // ================ end global variables ===============
 
-int discord_send(char option);
+DoorEvent event_for(char option);
+void handle_frame();
+void configure_atmega();
+void bus_changed(uint8_t node, char state);
+void record_event(char code, uint8_t node);
+void update_status();
+DoorEvent health_summary();
+String wifi_summary();
+void handle_wake();
 
 void setup() {
   Serial.begin(9600);
-  client->setFingerprint(fingerprint);
+  governor.begin();
 
-  //connect to wifi
-  WiFi.mode(WIFI_STA);
+#if NOTIFY_WEBHOOK
+  notifiers.add(&webhook);
+#endif
+#if NOTIFY_MQTT
+  notifiers.add(&mqtt);
+#endif
+#if NOTIFY_UDP
+  notifiers.add(&udp);
+#endif
+#if NOTIFY_TCP
+  notifiers.add(&tcp);
+#endif
+  notifiers.begin();
+#if HEALTH_MQTT
+  healthSinks.add(&healthMqtt);
+#endif
+#if HEALTH_UDP
+  healthSinks.add(&healthUdp);
+#endif
+  healthSinks.begin();
+  telemetry.reset(notifiers);
+
+  //connect to wifi, WiFiMulti takes care of reconnecting later on
   WiFiMulti.addAP(SECRET_SSID, SECRET_PASSWORD);
+  wifi_connect_start(SECRET_SSID, SECRET_PASSWORD);
+
+#if DEEP_SLEEP_MODE
+  //awake only to post one event, run the whole wake at full speed
+  governor.boost();
+  handle_wake(); // does not return
+#else
+  eventLog.begin();
+  {
+    CpuBoost boost(governor);
+    wifi_connect_finish(WIFI_TIMEOUT_MS);
+  }
+  //event log timestamps, until synced they count from boot
+  configTime(0, 0, NTP_SERVER);
+  if (STATUS_HTTP_PORT)
+  {
+    statusServer.begin();
+  }
+#if BUS_COORDINATOR
+  bus.begin(bus_changed);
+#else
+  configure_atmega();
+#endif
+  update_status();
+#endif
 }
 
 void loop() {
-  // as long as connected to wifi
-  if ((WiFiMulti.run() == WL_CONNECTED))
+#if BUS_COORDINATOR
+  //keep polling while WiFi is down, changes are queued and sent by notifiers.loop()
+  bus.loop();
+
+  //node tables change on every reply, refresh the precomputed status now and then
+  static unsigned long statusMs;
+  if (millis() - statusMs >= STATUS_BUS_REFRESH_MS)
   {
-    if (Serial.available())
+    statusMs = millis();
+    update_status();
+  }
+#endif
+
+  bool online = WiFiMulti.run() == WL_CONNECTED;
+
+  //read and log events while WiFi is down too, only notifying has to wait
+  if (!BUS_COORDINATOR && Serial.available())
+  {
+    data = Serial.read();
+    governor.received();
+    FrameReader::Result frame = frames.feed((uint8_t)data);
+    if (frame == FrameReader::COMPLETE)
     {
-      data = Serial.read();
-      while (!https.begin(*client, url));
-      do
+      handle_frame();
+    }
+    else if (frame == FrameReader::PENDING)
+    {
+      //rest of the frame still to come
+    }
+    else if (data == LINK_HINT)
+    {
+      //open connections now so the event, if it comes, is sent over warm ones
+      if (online)
       {
-        code = discord_send(data);
-      } while (code < 0); //if code is negative that means error occurred and must retry
-      https.end();
+        CpuBoost boost(governor);
+        notifiers.prewarm();
+      }
+    }
+    else
+    {
+      //"OPEN" is repeated while the door stays open, log the change only
+      const LoggedEvent* last = eventLog.last();
+      if ((data == 'o' || data == 'c') && (!last || last->code != data))
+      {
+        record_event(data, 0);
+      }
+      if (online)
+      {
+        CpuBoost boost(governor);
+        notifiers.notify(event_for(data));
+      }
+      else
+      {
+        //sent by notifiers.loop() once WiFi is back
+        notifiers.queue(event_for(data));
+      }
     }
   }
+
+  //settings sent by configure_atmega() that were not acknowledged yet
+  commands.loop();
+
+  if (online)
+  {
+    //never through the door state backends, a summary is not a door state
+    if (TELEMETRY_WINDOW_MS && telemetry.due())
+    {
+      if (healthSinks.count())
+      {
+        CpuBoost boost(governor);
+        healthSinks.notify(health_summary());
+      }
+      telemetry.reset(notifiers);
+    }
+
+    //backends that failed are retried with backoff, unused warm connections closed
+    if (notifiers.pending() || healthSinks.pending())
+    {
+      CpuBoost boost(governor);
+      notifiers.loop();
+      healthSinks.loop();
+    }
+    else
+    {
+      notifiers.loop();
+      healthSinks.loop();
+    }
+  }
+
+  if (STATUS_HTTP_PORT)
+  {
+    statusServer.loop();
+  }
+
+  //waiting on the ATmega168, the bus coordinator has to keep polling
+  if (!BUS_COORDINATOR && !Serial.available() && !notifiers.pending() && !healthSinks.pending())
+  {
+    governor.idle();
+  }
 }
 
-int discord_send(char option)
+DoorEvent event_for(char option)
 {
-  String message;
+  DoorEvent event;
+  event.code = option;
 
   if (option == 'o')
   {
-    message = messageOpen;
+    event.text = messageOpen;
   }
   else if (option == 'c')
   {
-    message = messageClosed;
+    event.text = messageClosed;
   }
   else
   {
-    message = "Undefined";
+    event.text = "Undefined";
   }
 
-  https.addHeader("Content-Type", "application/json");
-  int httpsCode = https.POST("{\"content\":\"" + message + "\"}");
+  return event;
+}
+
+// only called for nodes that actually changed, not on every poll. Runs inside
+// bus.loop(), so the notification is only queued: notifiers.loop() sends it after
+// bus.loop() has returned, instead of a TLS handshake stalling the poll.
+void bus_changed(uint8_t node, char state)
+{
+  record_event(state, node);
+  DoorEvent event = event_for(state);
+  event.text = "Door " + String(node) + ": " + event.text;
+  notifiers.queue(event);
+}
+
+// history first, so it is kept even if every backend is down
+void record_event(char code, uint8_t node)
+{
+  eventLog.append(code, node);
+  update_status();
+}
+
+// rebuild the state part of /status, served as is until the next change
+void update_status()
+{
+  String json;
+#if BUS_COORDINATOR
+  json = "\"nodes\":[";
+  for (uint8_t i = 0; i < bus.count(); i++)
+  {
+    json += String(i ? "," : "") + "{\"id\":" + String(bus.node_id(i)) +
+            ",\"state\":\"" + String((char)bus.node(i).state) + "\"" +
+            ",\"online\":" + (bus.online(i) ? "true" : "false") + "}";
+  }
+  json += "]";
+#else
+  const LoggedEvent* last = eventLog.last();
+  json = last ? "\"state\":\"" + String(last->code) + "\",\"since\":" + String(last->time)
+              : String("\"state\":\"?\"");
+#endif
+  statusServer.set_status(json);
+}
+
+// telemetry window plus CPU time per clock since boot
+DoorEvent health_summary()
+{
+  DoorEvent event = telemetry.summary(notifiers);
+  event.text += ", " + governor.summary() + ", " + wifi_summary();
+#if NOTIFY_WEBHOOK
+  const PrewarmStats& warm = webhook.prewarm_stats();
+  event.text += ", prewarm " + String(warm.hints) + " hints, " + String(warm.warmed) +
+                " warmed, " + String(warm.hits) + " used " + String(warm.warm_average_ms()) +
+                " ms, " + String(warm.expired) + " expired, " + String(warm.coldSends) +
+                " cold " + String(warm.cold_average_ms()) + " ms, saved " +
+                String(warm.saved_ms()) + " ms";
+  const TlsInfo& tls = webhook.tls();
+  event.text += ", handshake " + String(tls.handshake_average_ms(0)) + " ms at 80 MHz (" +
+                String(tls.handshakes[0]) + "), " + String(tls.handshake_average_ms(1)) +
+                " ms at 160 MHz (" + String(tls.handshakes[1]) + ")";
+  event.text += ", tls rx " + String(tls.rxBuffer) + " B, mfln " +
+                String(!tls.probed ? "untried" : (tls.mfln ? "yes" : "no")) + ", " +
+                String(tls.fallbacks) + " fallbacks, heap " + String(tls.lastHeapBytes) +
+                " B last " + String(tls.maxHeapBytes) + " B max";
+#endif
+  return event;
+}
+
+// connects with and without the RTC cache, see wifi_cache.h
+String wifi_summary()
+{
+  WifiCacheStats wifi = wifi_cache_stats();
+  return "wifi " + String(wifi.hits) + " cached connects " + String(wifi.hit_average_ms()) +
+         " ms, " + String(wifi.misses) + " full " + String(wifi.miss_average_ms()) +
+         " ms, saved " + String(wifi.saved_ms()) + " ms, " + String(wifi.fallbacks) +
+         " cache failures " + String(wifi.fallbackTotalMs) + " ms lost";
+}
+
+void handle_frame()
+{
+  TelemetryRecord record;
+
+  if (frames.type() == FRAME_TELEMETRY &&
+      telemetry_parse(frames.payload(), frames.length(), record))
+  {
+    telemetry.add(record, WiFi.RSSI());
+    const uint8_t type = FRAME_TELEMETRY;
+    frame_write(Serial, FRAME_CMD_ACK, &type, 1);
+  }
+  else if (frames.type() == FRAME_ACK && frames.length() >= 2)
+  {
+    commands.acked(frames.payload()[0], frames.payload()[1]);
+  }
+}
+
+void set_atmega_param(uint8_t param, uint16_t value)
+{
+  const uint8_t payload[] = {param, (uint8_t)(value & 0xFF), (uint8_t)(value >> 8)};
+  commands.send(FRAME_CMD_SET_PARAM, payload, sizeof(payload));
+}
+
+void configure_atmega()
+{
+  if (ATMEGA_TELEMETRY_PERIOD_S)
+  {
+    set_atmega_param(PARAM_TELEMETRY_PERIOD_S, ATMEGA_TELEMETRY_PERIOD_S);
+  }
+  if (ATMEGA_OPEN_REPEAT_MS)
+  {
+    set_atmega_param(PARAM_OPEN_REPEAT_MS, ATMEGA_OPEN_REPEAT_MS);
+  }
+  if (ATMEGA_SAMPLE_FAST_MS && ATMEGA_SAMPLE_SLOW_MS)
+  {
+    const uint8_t payload[] = {ATMEGA_SAMPLE_FAST_MS & 0xFF, ATMEGA_SAMPLE_FAST_MS >> 8,
+                               ATMEGA_SAMPLE_SLOW_MS & 0xFF, ATMEGA_SAMPLE_SLOW_MS >> 8};
+    commands.send(FRAME_CMD_SAMPLE_RATE, payload, sizeof(payload));
+  }
+
+  //first record right away instead of after a full period
+  commands.send(FRAME_CMD_TELEMETRY, nullptr, 0);
+}
+
+// ================= deep sleep mode =================
+
+uint16_t get_u16(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+// read the next event from the ATmega168, -1 on timeout. The link counters it
+// sends after the last ACK are stored in stats.
+int wait_for_event(unsigned long timeoutMs, WakeStats& stats)
+{
+  unsigned long start = millis();
+  while (millis() - start < timeoutMs)
+  {
+    if (Serial.available())
+    {
+      int c = Serial.read();
+      FrameReader::Result frame = frames.feed((uint8_t)c);
+      if (frame == FrameReader::COMPLETE && frames.type() == FRAME_LINK_STATS &&
+          frames.length() >= 10)
+      {
+        const uint8_t* p = frames.payload();
+        stats.linkDelivered = get_u16(p);
+        stats.linkDropped   = get_u16(p + 2);
+        stats.linkRetries   = get_u16(p + 4);
+        stats.linkLastMs    = get_u16(p + 6);
+        stats.linkMaxMs     = get_u16(p + 8);
+      }
+      else if (frame == FrameReader::NONE && (c == 'o' || c == 'c'))
+      {
+        return c;
+      }
+    }
+    yield();
+  }
+  return -1;
+}
+
+// every WAKE_REPORT_POSTS posts, there is no other way to see them in deep sleep mode
+void report_wake_stats(WakeStats& stats)
+{
+  if (!healthSinks.count() || stats.posts - stats.reportedPosts < WAKE_REPORT_POSTS ||
+      WiFi.status() != WL_CONNECTED)
+  {
+    return;
+  }
+
+  DoorEvent event;
+  event.code = 't';
+  event.text = "wakes " + String(stats.wakes) + ", " + String(stats.posts) + " posts, " +
+               String(stats.failures) + " failed, boot to post " + String(stats.lastMs) +
+               " ms, mean " + String(stats.totalMs / stats.posts) + " max " +
+               String(stats.maxMs) + " ms; atmega " + String(stats.linkDelivered) +
+               " delivered, " + String(stats.linkDropped) + " dropped, " +
+               String(stats.linkRetries) + " retries, wake to ack " +
+               String(stats.linkLastMs) + " ms, max " + String(stats.linkMaxMs) + " ms; " +
+               wifi_summary();
+  if (healthSinks.notify(event) == 0 || healthSinks.flush(POST_RETRIES - 1))
+  {
+    stats.reportedPosts = stats.posts;
+  }
+}
+
+// true once every backend has the event, we are about to sleep so retry right away.
+// Without an ACK the ATmega168 wakes us up with the same event again; backends that
+// already got it then are skipped, so they do not publish it twice.
+bool post_event(char event, WakeStats& stats)
+{
+  uint32_t skip = 0;
+  if (stats.retryEvent == event && stats.wakes - stats.retryWake <= WAKE_RETRY_WAKES)
+  {
+    skip = stats.retryDelivered;
+  }
+
+  // the webhook is deferred by notify(), flush() makes all of its attempts
+  if (notifiers.notify(event_for(event), skip) == 0 || notifiers.flush(POST_RETRIES))
+  {
+    stats.retryEvent = 0;
+    return true;
+  }
+
+  stats.retryEvent = event;
+  stats.retryDelivered = skip | notifiers.delivered();
+  stats.retryWake = stats.wakes;
+  return false;
+}
+
+void handle_wake()
+{
+  WakeStats stats;
+  ESP.rtcUserMemoryRead(RTC_WAKE_STATS, (uint32_t*)&stats, sizeof(stats));
+  if (stats.magic != WAKE_STATS_MAGIC)
+  {
+    memset(&stats, 0, sizeof(stats));
+    stats.magic = WAKE_STATS_MAGIC;
+  }
+  stats.wakes++;
+
+  // WiFi is already coming up (see setup()), ask for the event meanwhile
+  Serial.write(LINK_READY);
+
+  int event;
+  unsigned long timeoutMs = EVENT_TIMEOUT_MS;
+  while ((event = wait_for_event(timeoutMs, stats)) >= 0)
+  {
+    if (wifi_connect_finish(WIFI_TIMEOUT_MS) && post_event(event, stats))
+    {
+      // millis() starts at boot, so this is close to wake-to-post latency. The
+      // ATmega168 measures the full wake line to ACK time on its side.
+      uint32_t latencyMs = millis();
+      stats.posts++;
+      stats.lastMs = latencyMs;
+      stats.totalMs += latencyMs;
+      if (latencyMs > stats.maxMs)
+      {
+        stats.maxMs = latencyMs;
+      }
+      Serial.write(LINK_ACK);
+    }
+    else
+    {
+      // no ACK, the ATmega168 wakes us up again
+      stats.failures++;
+    }
+    timeoutMs = LINK_LINGER_MS;
+  }
+
+  report_wake_stats(stats);
+
+  ESP.rtcUserMemoryWrite(RTC_WAKE_STATS, (uint32_t*)&stats, sizeof(stats));
+  Serial.flush();
 
-  return httpsCode;
+  // sleep until the ATmega168 pulls RST low again
+  ESP.deepSleep(0);
 }
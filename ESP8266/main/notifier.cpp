@@ -0,0 +1,598 @@
+#include "notifier.h"
+
+// ================= Notifier =================
+
+bool Notifier::notify(const DoorEvent& event)
+{
+  unsigned long start = millis();
+  bool ok = send(event);
+  uint32_t latencyMs = millis() - start;
+
+  if (!ok)
+  {
+    _stats.failures++;
+    return false;
+  }
+
+  _stats.sent++;
+  _stats.lastLatencyMs = latencyMs;
+  _stats.totalLatencyMs += latencyMs;
+  if (latencyMs > _stats.maxLatencyMs)
+  {
+    _stats.maxLatencyMs = latencyMs;
+  }
+  return true;
+}
+
+// ================= WebhookNotifier =================
+
+WebhookNotifier::WebhookNotifier(const char* url, const char* fingerprint)
+  : Notifier("webhook"), _url(url), _fingerprint(fingerprint),
+    _secure(new BearSSL::WiFiClientSecure), _tls(), _prewarm(), _warm(false), _warmAt(0),
+    _fallbackAt(0)
+{
+  _tls.rxBuffer = TLS_DEFAULT_RX_BUFFER;
+}
+
+bool WebhookNotifier::begin()
+{
+  _secure->setFingerprint(_fingerprint);
+  return true;
+}
+
+WiFiClient& WebhookNotifier::client()
+{
+  return secure() ? *_secure : _plain;
+}
+
+void WebhookNotifier::parse_host(String& host, uint16_t& port) const
+{
+  // "http[s]://host[:port]/path"
+  bool tls = secure();
+  host = String(_url).substring(tls ? 8 : 7);
+  int slash = host.indexOf('/');
+  if (slash >= 0)
+  {
+    host = host.substring(0, slash);
+  }
+  port = tls ? 443 : 80;
+  int colon = host.indexOf(':');
+  if (colon >= 0)
+  {
+    port = host.substring(colon + 1).toInt();
+    host = host.substring(0, colon);
+  }
+}
+
+void WebhookNotifier::probe_fragment_length()
+{
+  // a failed probe must mean the server refused, not that we are offline
+  if (WiFi.status() != WL_CONNECTED)
+  {
+    return;
+  }
+
+  String host;
+  uint16_t port;
+  parse_host(host, port);
+
+  // smallest fragment the server accepts, the probe does not need a handshake
+  static const uint16_t sizes[] = {512, 1024, 2048, 4096};
+  for (uint16_t size : sizes)
+  {
+    if (_secure->probeMaxFragmentLength(host.c_str(), port, size))
+    {
+      _tls.mfln = true;
+      _tls.rxBuffer = size;
+      _secure->setBufferSizes(size, TLS_TX_BUFFER);
+      break;
+    }
+  }
+  _tls.probed = true;
+}
+
+bool WebhookNotifier::probe_due() const
+{
+  if (!secure())
+  {
+    return false;
+  }
+  if (!_tls.probed)
+  {
+    return true;
+  }
+
+  // only after a fallback, a server that refused at the probe is not asked again
+  if (_tls.mfln || _tls.fallbacks == 0)
+  {
+    return false;
+  }
+  uint32_t waitMs = (uint32_t)TLS_REPROBE_MS << min<uint32_t>(_tls.fallbacks - 1, 4);
+  return millis() - _fallbackAt >= waitMs;
+}
+
+void WebhookNotifier::connection_result(bool ok)
+{
+  if (!secure() || !_tls.mfln)
+  {
+    return;
+  }
+  if (ok)
+  {
+    _tls.failures = 0;
+    return;
+  }
+
+  // offline says nothing about the buffers
+  if (WiFi.status() != WL_CONNECTED || ++_tls.failures < TLS_MFLN_FAILURES)
+  {
+    return;
+  }
+
+  // server agreed during the probe but connections keep failing, fall back
+  _tls.mfln = false;
+  _tls.failures = 0;
+  _tls.fallbacks++;
+  _tls.rxBuffer = TLS_DEFAULT_RX_BUFFER;
+  _secure->setBufferSizes(TLS_DEFAULT_RX_BUFFER, TLS_TX_BUFFER);
+  _fallbackAt = millis();
+}
+
+void WebhookNotifier::prewarm()
+{
+  _prewarm.hints++;
+  if (WiFi.status() != WL_CONNECTED)
+  {
+    return;
+  }
+
+  // hints repeat while the door stays near the threshold, keep the one we have
+  if (_warm && client().connected())
+  {
+    _warmAt = millis();
+    return;
+  }
+
+  // the probe has its own connection, do it first so the warm one uses its buffers
+  if (probe_due())
+  {
+    probe_fragment_length();
+  }
+
+  client().stop();
+  if (!handshake())
+  {
+    _warm = false;
+    return;
+  }
+
+  _warm = true;
+  _warmAt = millis();
+  _prewarm.warmed++;
+}
+
+bool WebhookNotifier::handshake()
+{
+  String host;
+  uint16_t port;
+  parse_host(host, port);
+
+  // the clock may be 80 or 160 MHz, see governor.h
+  int clock = ESP.getCpuFreqMHz() >= 160 ? 1 : 0;
+  unsigned long start = millis();
+  if (!client().connect(host.c_str(), port))
+  {
+    connection_result(false);
+    return false;
+  }
+
+  _tls.handshakes[clock]++;
+  _tls.handshakeTotalMs[clock] += millis() - start;
+  return true;
+}
+
+void WebhookNotifier::maintain()
+{
+  // no event followed the hint, do not hold the heap or the server's socket
+  if (_warm && (!client().connected() || millis() - _warmAt >= WEBHOOK_WARM_HOLD_MS))
+  {
+    client().stop();
+    _warm = false;
+    _prewarm.expired++;
+  }
+}
+
+bool WebhookNotifier::send(const DoorEvent& event)
+{
+  // plain http:// is only meant for local stand-in servers
+  if (probe_due())
+  {
+    probe_fragment_length();
+  }
+
+  // HTTPClient reuses a client that is already connected
+  bool warm = _warm && client().connected();
+  _warm = false;
+
+  unsigned long start = millis();
+  uint32_t heapBefore = ESP.getFreeHeap();
+  if (!warm)
+  {
+    // connect here rather than in POST() so the handshake can be timed
+    client().stop();
+    if (!handshake())
+    {
+      return false;
+    }
+  }
+
+  if (!_https.begin(client(), _url))
+  {
+    return false;
+  }
+
+  _https.addHeader("Content-Type", "application/json");
+  int httpsCode = _https.POST("{\"content\":\"" + event.text + "\"}");
+
+  // the connection and its buffers are still allocated until end()
+  uint32_t heapUsed = heapBefore - ESP.getFreeHeap();
+  _https.end();
+  uint32_t latencyMs = millis() - start;
+
+  if (httpsCode > 0 && warm)
+  {
+    _prewarm.hits++;
+    _prewarm.warmTotalMs += latencyMs;
+  }
+  else if (httpsCode > 0)
+  {
+    _prewarm.coldSends++;
+    _prewarm.coldTotalMs += latencyMs;
+  }
+
+  // a warm connection allocated its buffers before heapBefore was taken
+  if (secure() && httpsCode > 0 && !warm)
+  {
+    _tls.lastHeapBytes = heapUsed;
+    if (heapUsed > _tls.maxHeapBytes)
+    {
+      _tls.maxHeapBytes = heapUsed;
+    }
+  }
+
+  connection_result(httpsCode > 0);
+  return httpsCode >= 200 && httpsCode < 300;
+}
+
+// ================= MqttNotifier =================
+
+MqttNotifier::MqttNotifier(const char* host, uint16_t port, const char* clientId,
+                           const char* topic, bool retain)
+  : Notifier("mqtt"), _host(host), _port(port), _clientId(clientId), _topic(topic),
+    _retain(retain)
+{
+}
+
+bool MqttNotifier::write_packet(uint8_t header, const uint8_t* body, size_t length)
+{
+  uint8_t fixed[5];
+  size_t used = 0;
+
+  fixed[used++] = header;
+  // remaining length, 7 bits per byte, least significant first
+  size_t remaining = length;
+  do
+  {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    fixed[used++] = digit | (remaining ? 0x80 : 0);
+  } while (remaining && used < sizeof(fixed));
+
+  return _client.write(fixed, used) == used && _client.write(body, length) == length;
+}
+
+bool MqttNotifier::connect()
+{
+  _client.stop();
+  _client.setTimeout(NOTIFIER_TIMEOUT_MS);
+  _client.setNoDelay(true);
+  if (!_client.connect(_host, _port))
+  {
+    return false;
+  }
+
+  // CONNECT: protocol "MQTT" level 4, clean session, keep alive disabled
+  size_t idLength = strlen(_clientId);
+  uint8_t body[12 + 64];
+  if (idLength > 64)
+  {
+    idLength = 64;
+  }
+  const uint8_t header[] = {0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 0};
+  memcpy(body, header, sizeof(header));
+  body[10] = idLength >> 8;
+  body[11] = idLength & 0xFF;
+  memcpy(body + 12, _clientId, idLength);
+
+  if (!write_packet(0x10, body, 12 + idLength))
+  {
+    return false;
+  }
+
+  // CONNACK: 0x20 0x02 flags return-code
+  uint8_t ack[4];
+  if (_client.readBytes(ack, sizeof(ack)) != sizeof(ack) || ack[0] != 0x20 || ack[3] != 0)
+  {
+    _client.stop();
+    return false;
+  }
+  return true;
+}
+
+void MqttNotifier::prewarm()
+{
+  if (!_client.connected())
+  {
+    connect();
+  }
+}
+
+bool MqttNotifier::send(const DoorEvent& event)
+{
+  if (!_client.connected() && !connect())
+  {
+    return false;
+  }
+
+  // PUBLISH, QoS 0
+  size_t topicLength = strlen(_topic);
+  size_t length = 2 + topicLength + event.text.length();
+  std::unique_ptr<uint8_t[]> body(new uint8_t[length]);
+  body[0] = topicLength >> 8;
+  body[1] = topicLength & 0xFF;
+  memcpy(body.get() + 2, _topic, topicLength);
+  memcpy(body.get() + 2 + topicLength, event.text.c_str(), event.text.length());
+
+  if (!write_packet(_retain ? 0x31 : 0x30, body.get(), length))
+  {
+    _client.stop();
+    return false;
+  }
+  return true;
+}
+
+// ================= UdpNotifier =================
+
+UdpNotifier::UdpNotifier(const char* host, uint16_t port)
+  : Notifier("udp"), _host(host), _port(port)
+{
+}
+
+bool UdpNotifier::send(const DoorEvent& event)
+{
+  if (!_udp.beginPacket(_host, _port))
+  {
+    return false;
+  }
+  _udp.write(event.code);
+  _udp.write(' ');
+  _udp.write(event.text.c_str(), event.text.length());
+  return _udp.endPacket() == 1;
+}
+
+// ================= TcpNotifier =================
+
+TcpNotifier::TcpNotifier(const char* host, uint16_t port)
+  : Notifier("tcp"), _host(host), _port(port)
+{
+}
+
+bool TcpNotifier::connect()
+{
+  _client.stop();
+  _client.setTimeout(NOTIFIER_TIMEOUT_MS);
+  _client.setNoDelay(true);
+  return _client.connect(_host, _port);
+}
+
+void TcpNotifier::prewarm()
+{
+  if (!_client.connected())
+  {
+    connect();
+  }
+}
+
+bool TcpNotifier::send(const DoorEvent& event)
+{
+  if (!_client.connected() && !connect())
+  {
+    return false;
+  }
+
+  String line = String(event.code) + " " + event.text + "\n";
+  if (_client.print(line) != line.length())
+  {
+    _client.stop();
+    return false;
+  }
+  return true;
+}
+
+// ================= NotifierGroup =================
+
+bool NotifierGroup::add(Notifier* backend)
+{
+  if (_count >= NOTIFIER_MAX_BACKENDS)
+  {
+    return false;
+  }
+
+  // keep the slots ordered by priority
+  int i = _count++;
+  while (i > 0 && _slots[i - 1].backend->priority() > backend->priority())
+  {
+    _slots[i].backend = _slots[i - 1].backend;
+    i--;
+  }
+  _slots[i].backend = backend;
+
+  for (int j = 0; j < _count; j++)
+  {
+    _slots[j].head = 0;
+    _slots[j].size = 0;
+    _slots[j].retryAt = 0;
+    _slots[j].backoffMs = NOTIFIER_RETRY_MIN_MS;
+  }
+  return true;
+}
+
+void NotifierGroup::begin()
+{
+  for (int i = 0; i < _count; i++)
+  {
+    _slots[i].backend->begin();
+  }
+}
+
+void NotifierGroup::enqueue(Slot& slot, const DoorEvent& event)
+{
+  if (slot.size == NOTIFIER_QUEUE_SIZE)
+  {
+    // drop the oldest, the newest state matters most
+    slot.head = (slot.head + 1) % NOTIFIER_QUEUE_SIZE;
+    slot.size--;
+    slot.backend->_stats.dropped++;
+  }
+  slot.queue[(slot.head + slot.size) % NOTIFIER_QUEUE_SIZE] = event;
+  slot.size++;
+}
+
+bool NotifierGroup::deliver(Slot& slot)
+{
+  if (!slot.backend->notify(slot.queue[slot.head]))
+  {
+    slot.retryAt = millis() + slot.backoffMs;
+    slot.backoffMs = min<unsigned long>(slot.backoffMs * 2, NOTIFIER_RETRY_MAX_MS);
+    return false;
+  }
+
+  slot.head = (slot.head + 1) % NOTIFIER_QUEUE_SIZE;
+  slot.size--;
+  slot.backoffMs = NOTIFIER_RETRY_MIN_MS;
+  return true;
+}
+
+void NotifierGroup::defer(Slot& slot, const DoorEvent& event)
+{
+  if (slot.size == 0)
+  {
+    slot.retryAt = millis();
+  }
+  enqueue(slot, event);
+}
+
+int NotifierGroup::notify(const DoorEvent& event, uint32_t skip)
+{
+  int failed = 0;
+
+  for (int i = 0; i < _count; i++)
+  {
+    Slot& slot = _slots[i];
+    if (skip & (1UL << i))
+    {
+      continue;
+    }
+    if (blocking(slot))
+    {
+      defer(slot, event);
+      failed++;
+      continue;
+    }
+
+    // events still waiting for a retry go first, keep the order
+    bool waiting = slot.size > 0;
+    enqueue(slot, event);
+    if (waiting || !deliver(slot))
+    {
+      failed++;
+    }
+  }
+  return failed;
+}
+
+void NotifierGroup::queue(const DoorEvent& event)
+{
+  for (int i = 0; i < _count; i++)
+  {
+    defer(_slots[i], event);
+  }
+}
+
+void NotifierGroup::prewarm()
+{
+  for (int i = 0; i < _count; i++)
+  {
+    _slots[i].backend->prewarm();
+  }
+}
+
+void NotifierGroup::loop()
+{
+  bool blocked = false;
+
+  for (int i = 0; i < _count; i++)
+  {
+    Slot& slot = _slots[i];
+    if (slot.size > 0 && (long)(millis() - slot.retryAt) >= 0)
+    {
+      if (!blocking(slot))
+      {
+        while (slot.size > 0 && deliver(slot));
+      }
+      else if (!blocked)
+      {
+        // one event, the rest waits for the next call
+        blocked = true;
+        deliver(slot);
+      }
+    }
+    slot.backend->maintain();
+  }
+}
+
+bool NotifierGroup::flush(int attempts)
+{
+  for (int attempt = 0; attempt < attempts && pending() > 0; attempt++)
+  {
+    for (int i = 0; i < _count; i++)
+    {
+      Slot& slot = _slots[i];
+      while (slot.size > 0 && deliver(slot));
+    }
+  }
+  return pending() == 0;
+}
+
+uint32_t NotifierGroup::delivered() const
+{
+  uint32_t mask = 0;
+  for (int i = 0; i < _count; i++)
+  {
+    if (_slots[i].size == 0)
+    {
+      mask |= 1UL << i;
+    }
+  }
+  return mask;
+}
+
+int NotifierGroup::pending() const
+{
+  int total = 0;
+  for (int i = 0; i < _count; i++)
+  {
+    total += _slots[i].size;
+  }
+  return total;
+}
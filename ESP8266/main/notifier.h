@@ -0,0 +1,273 @@
+// Notifier backends.
+//
+// Every way of publishing a door event implements Notifier. A NotifierGroup fans
+// one event out to all registered backends, each with its own small queue. The LAN
+// transports are sent right away, fastest first. Backends whose send blocks for a
+// TLS handshake (priority NOTIFIER_DEFER_PRIORITY and up, e.g. the webhook) only get
+// the event queued; NotifierGroup::loop() sends it, one blocking send per call, so
+// the main loop reads the serial line and serves the LAN in between. A backend that
+// fails keeps the event and is retried from loop() with exponential backoff,
+// independently of the others. Each backend keeps its own latency and failure
+// counters, and delivered() tells which backends already have the last event, so a
+// retry of that event (e.g. after the next deep sleep wake) can skip them.
+//
+// The ATmega168 sends a hint when the door reading nears the threshold.
+// NotifierGroup::prewarm() then lets every backend open its connection ahead of
+// the event, so the TLS handshake is not part of the notification latency.
+//
+// The ESP8266 has a single core and BearSSL connects synchronously, so "fan out"
+// means the cheap transports first and the blocking ones interleaved with the
+// main loop, not parallel sends.
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266HTTPClient.h>
+#include <WiFiClientSecureBearSSL.h>
+#include <WiFiUdp.h>
+
+#define NOTIFIER_MAX_BACKENDS   4
+#define NOTIFIER_QUEUE_SIZE     4      // undelivered events kept per backend
+#define NOTIFIER_RETRY_MIN_MS   1000
+#define NOTIFIER_RETRY_MAX_MS   30000
+#define NOTIFIER_TIMEOUT_MS     2000   // connect/response timeout for LAN transports
+#define NOTIFIER_DEFER_PRIORITY 10     // backends at or above are sent from loop()
+#define TLS_DEFAULT_RX_BUFFER   16384  // required unless the server accepts a smaller fragment
+#define TLS_TX_BUFFER           512
+#define TLS_MFLN_FAILURES       3      // failed connections in a row before dropping MFLN
+#define TLS_REPROBE_MS          3600000  // after dropping it, probe again; doubles each time
+#define WEBHOOK_WARM_HOLD_MS    15000  // warm connection kept this long waiting for an event
+
+struct DoorEvent {
+  char   code;      // 'o', 'c', or another message type
+  String text;      // human readable message
+};
+
+struct NotifierStats {
+  uint32_t sent;
+  uint32_t failures;        // failed attempts, including retries
+  uint32_t dropped;         // events lost because the retry queue was full
+  uint32_t lastLatencyMs;
+  uint32_t maxLatencyMs;
+  uint32_t totalLatencyMs;  // sum over successful sends, for the average
+};
+
+class Notifier {
+public:
+  explicit Notifier(const char* name) : _name(name), _stats() {}
+  virtual ~Notifier() {}
+
+  virtual bool begin() { return true; }
+  // an event is likely soon, connect now if the transport has a connection
+  virtual void prewarm() {}
+  // called from NotifierGroup::loop(), e.g. to close idle connections
+  virtual void maintain() {}
+  // lower runs first, LAN transports before cloud ones
+  virtual int priority() const = 0;
+
+  const char* name() const { return _name; }
+  const NotifierStats& stats() const { return _stats; }
+
+  // send and account for latency/failure
+  bool notify(const DoorEvent& event);
+
+protected:
+  virtual bool send(const DoorEvent& event) = 0;
+
+private:
+  friend class NotifierGroup;
+
+  const char*   _name;
+  NotifierStats _stats;
+};
+
+struct TlsInfo {
+  uint16_t rxBuffer;        // receive buffer in use, TLS_DEFAULT_RX_BUFFER without MFLN
+  bool     probed;          // max fragment length negotiation tried
+  bool     mfln;            // server accepted a max fragment length
+  uint8_t  failures;        // connections in a row that failed with small buffers
+  uint32_t fallbacks;       // times the default buffers were restored
+  uint32_t lastHeapBytes;   // heap taken by the last connection
+  uint32_t maxHeapBytes;
+  uint32_t handshakes[2];       // connections made at [0] 80 MHz, [1] 160 MHz
+  uint32_t handshakeTotalMs[2]; // connect time, TCP and TLS, summed per clock
+
+  uint32_t handshake_average_ms(int clock) const
+  {
+    return handshakes[clock] ? handshakeTotalMs[clock] / handshakes[clock] : 0;
+  }
+};
+
+struct PrewarmStats {
+  uint32_t hints;           // prewarm requests
+  uint32_t warmed;          // connections opened ahead of an event
+  uint32_t hits;            // events sent over a warm connection
+  uint32_t expired;         // warm connections closed unused
+  uint32_t warmTotalMs;     // send latency summed over hits
+  uint32_t coldSends;       // events that had to connect first
+  uint32_t coldTotalMs;
+
+  uint32_t warm_average_ms() const { return hits ? warmTotalMs / hits : 0; }
+  uint32_t cold_average_ms() const { return coldSends ? coldTotalMs / coldSends : 0; }
+  // average latency a warm connection saved over a cold one
+  int32_t saved_ms() const
+  {
+    return (hits && coldSends) ? (int32_t)cold_average_ms() - (int32_t)warm_average_ms() : 0;
+  }
+};
+
+// HTTPS (or plain HTTP, for local stand-ins) webhook with a Discord style JSON body.
+//
+// The first HTTPS send probes the server for TLS max fragment length support. If it
+// accepts one, the BearSSL buffers shrink from 16 KB + 512 B to a few KB. If it
+// does not, the defaults are used. A single failed connection may just be WiFi or
+// DNS, so small buffers are only given up after TLS_MFLN_FAILURES failures in a
+// row while WiFi is up, and the server is probed again TLS_REPROBE_MS later.
+//
+// prewarm() resolves the host and completes the handshake right away. The next
+// send() reuses that connection, if it comes within WEBHOOK_WARM_HOLD_MS.
+class WebhookNotifier : public Notifier {
+public:
+  WebhookNotifier(const char* url, const char* fingerprint);
+  bool begin() override;
+  int priority() const override { return 10; }
+  void prewarm() override;
+  void maintain() override;
+  const TlsInfo& tls() const { return _tls; }
+  const PrewarmStats& prewarm_stats() const { return _prewarm; }
+
+protected:
+  bool send(const DoorEvent& event) override;
+
+private:
+  bool secure() const { return strncmp(_url, "https:", 6) == 0; }
+  WiFiClient& client();
+  void parse_host(String& host, uint16_t& port) const;
+  // connect client() to the URL's host, timed into _tls
+  bool handshake();
+  bool probe_due() const;
+  void probe_fragment_length();
+  // account for a connection made with small buffers, falls back if they keep failing
+  void connection_result(bool ok);
+
+  const char* _url;
+  const char* _fingerprint;
+  HTTPClient  _https;
+  std::unique_ptr<BearSSL::WiFiClientSecure> _secure;
+  WiFiClient  _plain;
+  TlsInfo     _tls;
+  PrewarmStats  _prewarm;
+  bool          _warm;
+  unsigned long _warmAt;
+  unsigned long _fallbackAt;
+};
+
+// MQTT 3.1.1 publish, QoS 0, over a connection that is kept open. Door states are
+// retained so new subscribers get the current one, health summaries are not.
+class MqttNotifier : public Notifier {
+public:
+  MqttNotifier(const char* host, uint16_t port, const char* clientId, const char* topic,
+               bool retain = true);
+  int priority() const override { return 1; }
+  void prewarm() override;
+
+protected:
+  bool send(const DoorEvent& event) override;
+
+private:
+  bool connect();
+  bool write_packet(uint8_t header, const uint8_t* body, size_t length);
+
+  const char* _host;
+  uint16_t    _port;
+  const char* _clientId;
+  const char* _topic;
+  bool        _retain;
+  WiFiClient  _client;
+};
+
+// one datagram per event: "<code> <text>"
+class UdpNotifier : public Notifier {
+public:
+  UdpNotifier(const char* host, uint16_t port);
+  int priority() const override { return 0; }
+
+protected:
+  bool send(const DoorEvent& event) override;
+
+private:
+  const char* _host;
+  uint16_t    _port;
+  WiFiUDP     _udp;
+};
+
+// one line per event: "<code> <text>\n", over a connection that is kept open
+class TcpNotifier : public Notifier {
+public:
+  TcpNotifier(const char* host, uint16_t port);
+  int priority() const override { return 1; }
+  void prewarm() override;
+
+protected:
+  bool send(const DoorEvent& event) override;
+
+private:
+  bool connect();
+
+  const char* _host;
+  uint16_t    _port;
+  WiFiClient  _client;
+};
+
+class NotifierGroup {
+public:
+  NotifierGroup() : _count(0) {}
+
+  bool add(Notifier* backend);
+  void begin();
+
+  // send to every backend except those whose bit (1 << index) is set in skip.
+  // Returns the number of backends that do not have it yet: failed, or deferred
+  // to loop() (see NOTIFIER_DEFER_PRIORITY).
+  int notify(const DoorEvent& event, uint32_t skip = 0);
+  // queue for every backend without sending, e.g. while WiFi is down; loop() sends it
+  void queue(const DoorEvent& event);
+  // let every backend connect ahead of a likely event
+  void prewarm();
+  // send deferred events and retry queued ones whose backoff has expired, at most
+  // one blocking send per call; run backend housekeeping
+  void loop();
+  // retry every queued event now, up to attempts times; true once all delivered
+  bool flush(int attempts);
+
+  int count() const { return _count; }
+  int pending() const;
+  // bit (1 << index) set for every backend with nothing queued
+  uint32_t delivered() const;
+  Notifier* backend(int i) const { return _slots[i].backend; }
+
+private:
+  struct Slot {
+    Notifier*     backend;
+    DoorEvent     queue[NOTIFIER_QUEUE_SIZE];
+    uint8_t       head;
+    uint8_t       size;
+    unsigned long retryAt;
+    unsigned long backoffMs;
+  };
+
+  bool deliver(Slot& slot);
+  void enqueue(Slot& slot, const DoorEvent& event);
+  // queue without sending, due for loop() right away unless backing off
+  void defer(Slot& slot, const DoorEvent& event);
+  static bool blocking(const Slot& slot)
+  {
+    return slot.backend->priority() >= NOTIFIER_DEFER_PRIORITY;
+  }
+
+  Slot _slots[NOTIFIER_MAX_BACKENDS];
+  int  _count;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "status_server.h"
+
+void StatusServer::begin()
+{
+  _server.on("/status", HTTP_GET, [this]() { handle_status(); });
+  _server.on("/history", HTTP_GET, [this]() { handle_history(); });
+  _server.begin();
+}
+
+void StatusServer::handle_status()
+{
+  _stats.statusRequests++;
+
+  const EventLogStats& log = _log.stats();
+  String body;
+  body.reserve(_status.length() + 128);
+  body = "{";
+  body += _status;
+  body += _status.length() ? ",\"log\":{\"appended\":" : "\"log\":{\"appended\":";
+  body += log.appended;
+  body += ",\"bytes\":";
+  body += log.bytes;
+  body += ",\"indexQueries\":";
+  body += log.indexQueries;
+  body += ",\"fileQueries\":";
+  body += log.fileQueries;
+  body += "},\"server\":{\"status\":";
+  body += _stats.statusRequests;
+  body += ",\"history\":";
+  body += _stats.historyRequests;
+  body += "}}";
+  _server.send(200, "application/json", body);
+}
+
+struct HistoryWriter {
+  ESP8266WebServer* server;
+  String chunk;
+  bool first;
+};
+
+static void write_event(const LoggedEvent& event, void* context)
+{
+  HistoryWriter& writer = *(HistoryWriter*)context;
+
+  writer.chunk += writer.first ? "{\"t\":" : ",{\"t\":";
+  writer.chunk += event.time;
+  writer.chunk += ",\"code\":\"";
+  writer.chunk += event.code;
+  writer.chunk += '"';
+  if (event.node)
+  {
+    writer.chunk += ",\"node\":";
+    writer.chunk += event.node;
+  }
+  writer.chunk += '}';
+  writer.first = false;
+
+  // a few hundred bytes per packet instead of one per event
+  if (writer.chunk.length() >= 512)
+  {
+    writer.server->sendContent(writer.chunk);
+    writer.chunk = "";
+  }
+}
+
+void StatusServer::handle_history()
+{
+  _stats.historyRequests++;
+
+  uint32_t from = _server.hasArg("from") ? strtoul(_server.arg("from").c_str(), nullptr, 10) : 0;
+  uint32_t to = _server.hasArg("to") ? strtoul(_server.arg("to").c_str(), nullptr, 10)
+                                     : UINT32_MAX;
+  long limit = _server.hasArg("limit") ? _server.arg("limit").toInt() : STATUS_HISTORY_DEFAULT;
+  limit = constrain(limit, 0, STATUS_HISTORY_MAX);
+
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  _server.send(200, "application/json", "[");
+
+  HistoryWriter writer = {&_server, String(), true};
+  _log.query(from, to, limit, write_event, &writer);
+
+  writer.chunk += ']';
+  _server.sendContent(writer.chunk);
+  _server.sendContent("");
+}
@@ -0,0 +1,55 @@
+// LAN status endpoint.
+//
+//   GET /status                     current state and counters, e.g.
+//                                   {"state":"o","since":1700000000,
+//                                    "log":{"appended":12,"bytes":40,
+//                                           "indexQueries":3,"fileQueries":1},
+//                                    "server":{"status":57,"history":4}}
+//   GET /history?from=&to=&limit=   logged events with from <= t <= to (seconds,
+//                                   see event_log.h), the newest limit of them
+//                                   (default 50, at most STATUS_HISTORY_MAX),
+//                                   oldest first: [{"t":1700000000,"code":"o"},...]
+//
+// The state part of /status is rebuilt only when the state changes and served from
+// that buffer, so dashboards can poll it as often as they like; only the counters,
+// a few numbers, are formatted per request. /history is answered from the event
+// log's RAM index when it reaches back far enough, "indexQueries" and "fileQueries"
+// show how often that was the case.
+#ifndef STATUS_SERVER_H
+#define STATUS_SERVER_H
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include "event_log.h"
+
+#define STATUS_HISTORY_DEFAULT 50
+#define STATUS_HISTORY_MAX     500
+
+struct StatusServerStats {
+  uint32_t statusRequests;
+  uint32_t historyRequests;
+};
+
+class StatusServer {
+public:
+  StatusServer(uint16_t port, EventLog& log) : _server(port), _log(log), _stats() {}
+
+  void begin();
+  // non-blocking, call from loop()
+  void loop() { _server.handleClient(); }
+
+  // replace the precomputed state, JSON object members without the braces
+  void set_status(const String& members) { _status = members; }
+  const StatusServerStats& stats() const { return _stats; }
+
+private:
+  void handle_status();
+  void handle_history();
+
+  ESP8266WebServer  _server;
+  EventLog&         _log;
+  String            _status;
+  StatusServerStats _stats;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <ESP8266WiFi.h>
+#include "telemetry.h"
+
+static uint16_t get_u16(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+bool telemetry_parse(const uint8_t* payload, uint8_t length, TelemetryRecord& record)
+{
+  uint8_t version = length ? payload[0] : 0;
+  if (version < 1 || version > TELEMETRY_VERSION || length < (version == 1 ? 12 : TELEMETRY_SIZE))
+  {
+    return false;
+  }
+
+  record.adcMin       = payload[1];
+  record.adcMax       = payload[2];
+  record.adcMean      = payload[3];
+  record.samples      = get_u16(&payload[4]);
+  record.transitions  = payload[6];
+  record.rxOverruns   = payload[7];
+  record.dutyPermille = get_u16(&payload[8]);
+  record.uptimeMin    = get_u16(&payload[10]);
+  record.rxHighWater  = version >= 2 ? payload[12] : 0;
+  return true;
+}
+
+void TelemetryWindow::reset(const NotifierGroup& notifiers)
+{
+  _startMs     = millis();
+  _records     = 0;
+  _adcMin      = 0xFF;
+  _adcMax      = 0;
+  _adcSum      = 0;
+  _samples     = 0;
+  _transitions = 0;
+  _rxOverruns  = 0;
+  _dutySum     = 0;
+  _uptimeMin   = 0;
+  _rxHighWater = 0;
+  _rssiMin     = 0;
+  _rssiMax     = -1000;
+  _rssiSum     = 0;
+
+  for (int i = 0; i < notifiers.count(); i++)
+  {
+    _start[i] = notifiers.backend(i)->stats();
+  }
+}
+
+void TelemetryWindow::add(const TelemetryRecord& record, int32_t rssi)
+{
+  _records++;
+  _adcMin = min(_adcMin, record.adcMin);
+  _adcMax = max(_adcMax, record.adcMax);
+  _adcSum += (uint32_t)record.adcMean * record.samples;
+  _samples += record.samples;
+  _transitions += record.transitions;
+  _rxOverruns += record.rxOverruns;
+  _dutySum += record.dutyPermille;
+  _uptimeMin = record.uptimeMin;
+  _rxHighWater = max(_rxHighWater, record.rxHighWater);
+
+  _rssiMin = min(_rssiMin, rssi);
+  _rssiMax = max(_rssiMax, rssi);
+  _rssiSum += rssi;
+}
+
+bool TelemetryWindow::due() const
+{
+  return _records > 0 && millis() - _startMs >= _windowMs;
+}
+
+DoorEvent TelemetryWindow::summary(const NotifierGroup& notifiers) const
+{
+  DoorEvent event;
+  event.code = 't';
+  event.text = "health " + String((millis() - _startMs) / 60000) + " min, " +
+               String(_records) + " records: adc " + String(_adcMin) + "-" + String(_adcMax) +
+               " mean " + String(_samples ? _adcSum / _samples : 0) +
+               ", " + String(_transitions) + " changes" +
+               ", " + String(_rxOverruns) + " rx overruns" +
+               " (buffer peak " + String(_rxHighWater) + " bytes)" +
+               ", duty " + String(_dutySum / _records) + " permille" +
+               ", rssi " + String(_rssiMax) + ".." + String(_rssiMin) +
+               " mean " + String(_rssiSum / (int32_t)_records) + " dBm";
+
+  for (int i = 0; i < notifiers.count(); i++)
+  {
+    const NotifierStats& now = notifiers.backend(i)->stats();
+    uint32_t sent = now.sent - _start[i].sent;
+    uint32_t latency = now.totalLatencyMs - _start[i].totalLatencyMs;
+    event.text += ", " + String(notifiers.backend(i)->name()) + " " + String(sent) + " sent" +
+                  (sent ? " " + String(latency / sent) + " ms" : String()) +
+                  " " + String(now.failures - _start[i].failures) + " retries";
+  }
+
+  event.text += ", uptime " + String(_uptimeMin) + " min";
+  return event;
+}
@@ -0,0 +1,66 @@
+// Health telemetry aggregation.
+//
+// The ATmega168 sends a small FRAME_TELEMETRY record every minute (layout in
+// ATmega168/include/telemetry.h). TelemetryWindow folds the records together with
+// what only the ESP8266 knows (WiFi RSSI, per backend latency and retries) and
+// produces one summary per window, so the health sinks see one message per window
+// instead of one per record. The summary goes to its own sinks (a non-retained MQTT
+// topic, a UDP collector), never to the backends that publish door states.
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include "notifier.h"
+
+#define TELEMETRY_VERSION  2
+#define TELEMETRY_SIZE     13     // version 1 records are 12 bytes, without rxHighWater
+
+struct TelemetryRecord {
+  uint8_t  adcMin;
+  uint8_t  adcMax;
+  uint8_t  adcMean;
+  uint16_t samples;
+  uint8_t  transitions;     // door state changes
+  uint8_t  rxOverruns;      // bytes lost by the ATmega168 receive buffer
+  uint16_t dutyPermille;    // sampling duty cycle
+  uint16_t uptimeMin;
+  uint8_t  rxHighWater;     // most bytes ever waiting in the ATmega168 receive buffer
+};
+
+// false if the payload is not a record this code understands
+bool telemetry_parse(const uint8_t* payload, uint8_t length, TelemetryRecord& record);
+
+class TelemetryWindow {
+public:
+  explicit TelemetryWindow(unsigned long windowMs) : _windowMs(windowMs) {}
+
+  // start a window, notifier counters are reported relative to this point
+  void reset(const NotifierGroup& notifiers);
+  void add(const TelemetryRecord& record, int32_t rssi);
+  // window over and something to report
+  bool due() const;
+  // one line summary of the window, for NotifierGroup::notify()
+  DoorEvent summary(const NotifierGroup& notifiers) const;
+
+  uint32_t records() const { return _records; }
+
+private:
+  unsigned long _windowMs;
+  unsigned long _startMs;
+  uint32_t _records;
+  uint8_t  _adcMin;
+  uint8_t  _adcMax;
+  uint32_t _adcSum;         // mean times samples, for the weighted mean
+  uint32_t _samples;
+  uint32_t _transitions;
+  uint32_t _rxOverruns;
+  uint32_t _dutySum;
+  uint16_t _uptimeMin;
+  uint8_t  _rxHighWater;
+  int32_t  _rssiMin;
+  int32_t  _rssiMax;
+  int32_t  _rssiSum;
+  NotifierStats _start[NOTIFIER_MAX_BACKENDS];
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include <ESP8266WiFi.h>
+#include "wifi_cache.h"
+
+// layout of the RTC user memory block, must be a multiple of 4 bytes
+struct WifiCache {
+  uint32_t crc;        // over everything after this field
+  uint8_t  bssid[6];
+  uint8_t  channel;
+  uint8_t  valid;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  WifiCacheStats stats;
+};
+
+static WifiCache cache;
+static const char* cachedSsid;
+static const char* cachedPassword;
+static unsigned long startMs;   // start of the current attempt, reset on fallback
+static bool usingCache;
+static bool recorded;   // stats already updated for this connection
+
+static uint32_t cache_crc(const WifiCache& c)
+{
+  const uint8_t* data = (const uint8_t*)&c + sizeof(c.crc);
+  size_t length = sizeof(c) - sizeof(c.crc);
+  uint32_t crc = 0xFFFFFFFF;
+
+  while (length--)
+  {
+    crc ^= *data++;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static void cache_load()
+{
+  ESP.rtcUserMemoryRead(RTC_WIFI_CACHE, (uint32_t*)&cache, sizeof(cache));
+  if (cache.crc != cache_crc(cache))
+  {
+    memset(&cache, 0, sizeof(cache));
+  }
+}
+
+static void cache_store()
+{
+  cache.crc = cache_crc(cache);
+  ESP.rtcUserMemoryWrite(RTC_WIFI_CACHE, (uint32_t*)&cache, sizeof(cache));
+}
+
+static void begin_with_dhcp()
+{
+  usingCache = false;
+  WiFi.config(0U, 0U, 0U);
+  WiFi.begin(cachedSsid, cachedPassword);
+}
+
+void wifi_connect_start(const char* ssid, const char* password)
+{
+  cachedSsid = ssid;
+  cachedPassword = password;
+  startMs = millis();
+  recorded = false;
+
+  // credentials come from secrets.h, do not write them to flash on every begin()
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+
+  cache_load();
+  if (cache.valid)
+  {
+    usingCache = true;
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet),
+                IPAddress(cache.dns));
+    WiFi.begin(ssid, password, cache.channel, cache.bssid, true);
+  }
+  else
+  {
+    begin_with_dhcp();
+  }
+}
+
+bool wifi_connect_finish(unsigned long timeoutMs)
+{
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    unsigned long waited = millis() - startMs;
+
+    if (usingCache && waited >= WIFI_CACHE_FAST_TIMEOUT_MS)
+    {
+      // access point moved, changed channel or refused the address
+      WiFi.disconnect();
+      cache.valid = 0;
+      cache.stats.fallbacks++;
+      cache.stats.fallbackTotalMs += waited;
+      startMs = millis();
+      begin_with_dhcp();
+    }
+    else if (waited >= timeoutMs)
+    {
+      return false;
+    }
+    delay(10);
+  }
+
+  if (recorded)
+  {
+    return true;
+  }
+  recorded = true;
+
+  bool hit = usingCache;
+  cache.stats.lastConnectMs = millis() - startMs;
+  cache.stats.lastHit = hit;
+  if (hit)
+  {
+    cache.stats.hits++;
+    cache.stats.hitTotalMs += cache.stats.lastConnectMs;
+  }
+  else
+  {
+    cache.stats.misses++;
+    cache.stats.missTotalMs += cache.stats.lastConnectMs;
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+    cache.ip = WiFi.localIP();
+    cache.gateway = WiFi.gatewayIP();
+    cache.subnet = WiFi.subnetMask();
+    cache.dns = WiFi.dnsIP();
+    cache.valid = 1;
+  }
+  cache_store();
+
+  return true;
+}
+
+void wifi_cache_invalidate()
+{
+  cache_load();
+  cache.valid = 0;
+  cache_store();
+}
+
+WifiCacheStats wifi_cache_stats()
+{
+  return cache.stats;
+}
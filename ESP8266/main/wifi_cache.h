@@ -0,0 +1,48 @@
+// Fast WiFi re-association.
+//
+// The BSSID, channel and IP configuration of the last successful connection are
+// kept in RTC user memory (survives resets and deep sleep, not power loss). When
+// they are valid the next connection skips the scan and DHCP: it joins the cached
+// access point directly with a static IP. If that fails within
+// WIFI_CACHE_FAST_TIMEOUT_MS the cache is dropped and a normal scan + DHCP
+// connection is made, which refills the cache. The fallback gets the full timeout
+// of its own, and the time lost on the failed cached attempt is counted apart
+// from the connect times.
+//
+// usage:
+//   wifi_connect_start(ssid, password);   // returns immediately
+//   ...                                   // other work while WiFi comes up
+//   wifi_connect_finish(timeoutMs);       // true once connected
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <Arduino.h>
+
+#define WIFI_CACHE_FAST_TIMEOUT_MS 3000
+#define RTC_WIFI_CACHE             16    // RTC user memory block, after WakeStats
+
+struct WifiCacheStats {
+  uint32_t hits;            // connected using the cache
+  uint32_t misses;          // no valid cache, or cached connect failed
+  uint32_t lastConnectMs;   // start of the connection that succeeded until connected
+  uint32_t hitTotalMs;      // connect time summed over hits, for the average
+  uint32_t missTotalMs;     // scan + DHCP connect time only
+  uint32_t fallbacks;       // cached connects that failed, counted in misses too
+  uint32_t fallbackTotalMs; // time lost on them before the scan + DHCP connect
+  bool     lastHit;
+
+  uint32_t hit_average_ms() const { return hits ? hitTotalMs / hits : 0; }
+  uint32_t miss_average_ms() const { return misses ? missTotalMs / misses : 0; }
+  // average time a cache hit saved over a scan + DHCP connect
+  int32_t saved_ms() const
+  {
+    return (hits && misses) ? (int32_t)miss_average_ms() - (int32_t)hit_average_ms() : 0;
+  }
+};
+
+void wifi_connect_start(const char* ssid, const char* password);
+bool wifi_connect_finish(unsigned long timeoutMs);
+void wifi_cache_invalidate();
+WifiCacheStats wifi_cache_stats();
+
+#endif
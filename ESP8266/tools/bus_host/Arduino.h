@@ -0,0 +1,31 @@
+// Just enough of the Arduino core to build main/bus.cpp and main/frame.cpp on the
+// host for tools/bus_sim.py. millis() runs on the simulated clock of bus_host.cpp.
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LOW    0
+#define HIGH   1
+#define OUTPUT 1
+
+unsigned long millis();
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+
+template <class T> T min(T a, T b) { return (b < a) ? b : a; }
+template <class T> T max(T a, T b) { return (a < b) ? b : a; }
+
+class Stream {
+public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual size_t write(const uint8_t* data, size_t size) = 0;
+  // returns once everything written has left the UART
+  virtual void flush() = 0;
+};
+
+#endif
@@ -0,0 +1,308 @@
+// Runs the real BusCoordinator (main/bus.cpp, main/frame.cpp) on the host against
+// virtual door nodes on a simulated RS-485 wire. Built and driven by
+// tools/bus_sim.py, which also documents the arguments.
+//
+// Time is simulated: every loop() call takes --loop-us, and Serial.flush() waits
+// for the poll to leave the wire at the configured baud rate. Nodes answer like
+// ATmega168/src/bus.c: BUS_TURNAROUND_MS after the poll, on the next 1 ms timer
+// tick, with the state they have at that point. Replies are built with
+// frame_write_to(), which has the same layout as the node's frame_send().
+//
+// Output, one run:
+//   cycles <n> cycle_total <ms> cycle_max <ms> polls <n> timeouts <n> coalesced <n>
+//
+// cycles counts the passes that polled at least one node, the same ones the
+// coordinator takes lastCycleMs from.
+//   latency <ms> <ms> ...
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <utility>
+#include <vector>
+#include "bus.h"
+
+extern "C" const int node_turnaround_ms;
+extern "C" const int node_status_size;
+
+static double nowMs;
+
+unsigned long millis() { return (unsigned long)nowMs; }
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+
+struct Node {
+  bool                alive;
+  std::vector<double> reports;    // times (ms) at which the node reports a new state
+  size_t              sent;       // state changes in the last reply sent
+  size_t              detected;   // state changes the coordinator has acted on
+  bool                baselined;  // the coordinator has had its first reply
+};
+
+struct Options {
+  int    nodes;
+  long   baud;
+  double durationS;
+  double eventIntervalS;
+  double sampleMs;
+  int    offline;
+  double loss;
+  double turnaroundUs;   // < 0: the firmware turnaround
+  double loopUs;
+  unsigned seed;
+};
+
+// collects one frame written by frame_write_to()
+class FrameBuffer : public Stream {
+public:
+  int available() { return 0; }
+  int read() { return -1; }
+  size_t write(const uint8_t* data, size_t size)
+  {
+    bytes.insert(bytes.end(), data, data + size);
+    return size;
+  }
+  void flush() {}
+
+  std::vector<uint8_t> bytes;
+};
+
+class Wire : public Stream {
+public:
+  typedef void (*PollHandler)(uint8_t address, double endMs);
+
+  Wire(double byteMs, PollHandler onPoll) : _byteMs(byteMs), _onPoll(onPoll) {}
+
+  int available()
+  {
+    int count = 0;
+    for (size_t i = 0; i < _rx.size() && _rx[i].first <= nowMs; i++)
+    {
+      count++;
+    }
+    return count;
+  }
+
+  int read()
+  {
+    if (_rx.empty() || _rx.front().first > nowMs)
+    {
+      return -1;
+    }
+    uint8_t byte = _rx.front().second;
+    _rx.pop_front();
+    return byte;
+  }
+
+  size_t write(const uint8_t* data, size_t size)
+  {
+    _tx.insert(_tx.end(), data, data + size);
+    return size;
+  }
+
+  void flush()
+  {
+    nowMs += _tx.size() * _byteMs;
+    // SOF, address, type
+    if (_tx.size() >= 3 && _tx[2] == FRAME_CMD_POLL)
+    {
+      _onPoll(_tx[1], nowMs);
+    }
+    _tx.clear();
+  }
+
+  // a node starts sending at startMs, each byte arrives after its stop bit
+  void send(double startMs, const std::vector<uint8_t>& bytes)
+  {
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+      _rx.push_back(std::make_pair(startMs + (i + 1) * _byteMs, bytes[i]));
+    }
+  }
+
+private:
+  double                                 _byteMs;
+  PollHandler                            _onPoll;
+  std::deque<std::pair<double, uint8_t>> _rx;
+  std::vector<uint8_t>                   _tx;
+};
+
+static Options options;
+static std::mt19937 rng;
+static std::vector<Node> nodes;
+static std::vector<double> latencies;
+static unsigned long coalesced;
+static Wire* wire;
+static BusCoordinator* bus;
+
+static double uniform()
+{
+  return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+}
+
+static size_t changes_at(const Node& node, double ms)
+{
+  size_t count = 0;
+  while (count < node.reports.size() && node.reports[count] <= ms)
+  {
+    count++;
+  }
+  return count;
+}
+
+static void on_poll(uint8_t address, double endMs)
+{
+  int index = address - 1;
+  if (index < 0 || index >= (int)nodes.size())
+  {
+    return;
+  }
+  Node& node = nodes[index];
+  if (!node.alive)
+  {
+    return;
+  }
+
+  // the first reply the coordinator took only set its baseline
+  if (!node.baselined && bus->node(index).missed == 0)
+  {
+    node.baselined = true;
+    node.detected = node.sent;
+  }
+
+  double gap = options.turnaroundUs < 0 ? node_turnaround_ms + uniform()
+                                        : options.turnaroundUs / 1000.0;
+  node.sent = changes_at(node, endMs + gap);
+
+  std::vector<uint8_t> status(node_status_size, 0);
+  status[0] = node.sent ? ((node.sent & 1) ? 'o' : 'c') : '?';
+  status[1] = (uint8_t)node.sent;
+
+  FrameBuffer frame;
+  frame_write_to(frame, address, FRAME_STATUS, status.data(), status.size());
+  if (uniform() < options.loss)
+  {
+    frame.bytes.back() ^= 0xFF;   // corrupted, the coordinator times out
+  }
+  wire->send(endMs + gap, frame.bytes);
+}
+
+static void on_change(uint8_t id, char)
+{
+  Node& node = nodes[id - 1];
+  for (size_t k = node.detected; k < node.sent; k++)
+  {
+    latencies.push_back(nowMs - node.reports[k]);
+  }
+  if (node.sent > node.detected + 1)
+  {
+    coalesced += node.sent - node.detected - 1;
+  }
+  node.detected = node.sent;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 11)
+  {
+    fprintf(stderr, "usage: bus_host nodes baud duration_s event_interval_s sample_ms "
+                    "offline loss turnaround_us loop_us seed\n");
+    return 2;
+  }
+  options.nodes          = atoi(argv[1]);
+  options.baud           = atol(argv[2]);
+  options.durationS      = atof(argv[3]);
+  options.eventIntervalS = atof(argv[4]);
+  options.sampleMs       = atof(argv[5]);
+  options.offline        = atoi(argv[6]);
+  options.loss           = atof(argv[7]);
+  options.turnaroundUs   = atof(argv[8]);
+  options.loopUs         = atof(argv[9]);
+  options.seed           = (unsigned)atol(argv[10]);
+
+  if (options.nodes < 1 || options.nodes > BUS_MAX_NODES)
+  {
+    fprintf(stderr, "bus_host: 1 to %d nodes (BUS_MAX_NODES)\n", BUS_MAX_NODES);
+    return 2;
+  }
+
+  rng.seed(options.seed);
+  double endMs = options.durationS * 1000.0;
+  std::exponential_distribution<double> interval(1.0 / (options.eventIntervalS * 1000.0));
+
+  std::vector<int> order(options.nodes);
+  for (int i = 0; i < options.nodes; i++)
+  {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), rng);
+
+  nodes.resize(options.nodes);
+  for (int i = 0; i < options.nodes; i++)
+  {
+    Node& node = nodes[i];
+    node.alive = true;
+    node.sent = node.detected = 0;
+    node.baselined = false;
+    for (double t = interval(rng); t < endMs; t += interval(rng))
+    {
+      double report = t;
+      if (options.sampleMs > 0)
+      {
+        report = ((long)(t / options.sampleMs) + 1) * options.sampleMs;
+      }
+      if (node.reports.empty() || report > node.reports.back())
+      {
+        node.reports.push_back(report);
+      }
+    }
+  }
+  for (int i = 0; i < options.offline && i < options.nodes; i++)
+  {
+    nodes[order[i]].alive = false;
+  }
+
+  // start, 8 data bits, stop
+  Wire line(10 * 1000.0 / options.baud, on_poll);
+  BusCoordinator coordinator(line, 0, 1, options.nodes);
+  wire = &line;
+  bus = &coordinator;
+  coordinator.begin(on_change);
+
+  const BusStats& stats = coordinator.stats();
+  unsigned long cycles = 0;
+  unsigned long cycleTotalMs = 0;
+  uint32_t passPolls = 0;
+  while (nowMs < endMs)
+  {
+    uint32_t polls = stats.polls;
+    uint32_t passes = stats.cycles;
+
+    coordinator.loop();
+
+    // a new pass starts before its first poll
+    if (stats.cycles != passes)
+    {
+      if (passPolls > 0)
+      {
+        cycles++;
+        cycleTotalMs += stats.lastCycleMs;
+      }
+      passPolls = 0;
+    }
+    passPolls += stats.polls - polls;
+    nowMs += options.loopUs / 1000.0;
+  }
+
+  printf("cycles %lu cycle_total %lu cycle_max %lu polls %lu timeouts %lu coalesced %lu\n",
+         cycles, cycleTotalMs, (unsigned long)stats.maxCycleMs,
+         (unsigned long)stats.polls, (unsigned long)stats.timeouts, coalesced);
+  printf("latency");
+  for (size_t i = 0; i < latencies.size(); i++)
+  {
+    printf(" %.2f", latencies[i]);
+  }
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,9 @@
+/*
+ * Node side of the bus for bus_host.cpp, taken from the ATmega168 headers so the
+ * simulated nodes answer like the firmware does.
+ */
+
+#include "bus.h"
+
+const int node_turnaround_ms = BUS_TURNAROUND_MS;
+const int node_status_size   = BUS_STATUS_SIZE;
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Simulate the RS-485 polling bus (ESP8266/main/bus.h, ATmega168/include/bus.h) with
+many virtual door nodes and report how polling latency grows with the node count.
+
+The coordinator is the real one: main/bus.cpp and main/frame.cpp are built for the
+host with tools/bus_host (a C++ compiler is needed, $CXX or c++) and run on a
+simulated wire, so timeouts, offline handling and frame sizes follow the firmware.
+The nodes answer like ATmega168/src/bus.c, with BUS_TURNAROUND_MS and
+BUS_STATUS_SIZE taken from ATmega168/include/bus.h. The numbers are what the wire
+allows, not what WiFi adds on top.
+
+Every virtual node opens and closes its door at random (exponential intervals).
+A change is "reported" when the node's next sample sees it (--sample-ms, 0 for
+bus latency only) and "detected" when the coordinator processes the poll reply
+that carries it. Several changes between two polls reach the coordinator in one
+reply; those are counted as coalesced.
+
+usage:
+    bus_sim.py [--nodes 1,2,4,8,16,32,64] [--baud 9600] [--duration 600]
+               [--event-interval 60] [--sample-ms 0] [--offline 0] [--loss 0]
+               [--turnaround-us firmware] [--loop-us 200] [--seed 1]
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+HOST = os.path.join(TOOLS, "bus_host")
+MAIN = os.path.join(TOOLS, "..", "main")
+NODE_INCLUDE = os.path.join(TOOLS, "..", "..", "ATmega168", "include")
+
+
+def build(directory):
+    cc = os.environ.get("CC", "cc")
+    cxx = os.environ.get("CXX", "c++")
+    node = os.path.join(directory, "node_config.o")
+    program = os.path.join(directory, "bus_host")
+    subprocess.check_call([cc, "-std=c99", "-c", "-DBUS_MODE=1", "-I", NODE_INCLUDE,
+                           os.path.join(HOST, "node_config.c"), "-o", node])
+    subprocess.check_call([cxx, "-std=c++11", "-O2", "-I", HOST, "-I", MAIN,
+                           os.path.join(HOST, "bus_host.cpp"),
+                           os.path.join(MAIN, "bus.cpp"), os.path.join(MAIN, "frame.cpp"),
+                           node, "-o", program])
+    return program
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100.0 * len(values)))]
+
+
+def simulate(program, count, args):
+    turnaround = -1 if args.turnaround_us is None else args.turnaround_us
+    output = subprocess.check_output([program] + [str(v) for v in (
+        count, args.baud, args.duration, args.event_interval, args.sample_ms, args.offline,
+        args.loss, turnaround, args.loop_us, args.seed)], universal_newlines=True)
+    summary, latency = output.splitlines()[:2]
+    fields = summary.split()
+    r = {fields[i]: int(fields[i + 1]) for i in range(0, len(fields), 2)}
+    latencies = [float(v) for v in latency.split()[1:]]
+
+    return {
+        "cycle_mean": float(r["cycle_total"]) / r["cycles"] if r["cycles"] else 0.0,
+        "cycle_max": r["cycle_max"],
+        "p50": percentile(latencies, 50),
+        "p95": percentile(latencies, 95),
+        "max": max(latencies) if latencies else 0.0,
+        "events": len(latencies),
+        "coalesced": r["coalesced"],
+        "polls_per_s": r["polls"] / args.duration,
+        "timeouts": r["timeouts"],
+    }
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="RS-485 polling bus simulation")
+    parser.add_argument("--nodes", default="1,2,4,8,16,32,64",
+                        help="comma separated node counts to simulate, up to BUS_MAX_NODES")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--duration", type=float, default=600, help="seconds simulated")
+    parser.add_argument("--event-interval", type=float, default=60,
+                        help="mean seconds between door changes per node")
+    parser.add_argument("--sample-ms", type=float, default=0,
+                        help="node sampling period, 0 to measure the bus alone")
+    parser.add_argument("--offline", type=int, default=0, help="nodes that never answer")
+    parser.add_argument("--loss", type=float, default=0.0,
+                        help="probability a reply is lost or corrupted")
+    parser.add_argument("--turnaround-us", type=float, default=None,
+                        help="end of poll until the node starts its reply, "
+                             "default BUS_TURNAROUND_MS plus up to one timer tick")
+    parser.add_argument("--loop-us", type=float, default=200,
+                        help="coordinator time per loop() call outside the wire")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args(argv[1:])
+
+    directory = tempfile.mkdtemp(prefix="bus_sim")
+    try:
+        program = build(directory)
+        counts = [int(n) for n in args.nodes.split(",") if n]
+        print("%5s %10s %10s %9s %9s %9s %7s %9s %9s %8s" % (
+            "nodes", "cycle ms", "cycle max", "p50 ms", "p95 ms", "max ms",
+            "events", "coalesced", "polls/s", "timeouts"))
+        for count in counts:
+            r = simulate(program, count, args)
+            print("%5d %10.1f %10.1f %9.1f %9.1f %9.1f %7d %9d %9.1f %8d" % (
+                count, r["cycle_mean"], r["cycle_max"], r["p50"], r["p95"], r["max"],
+                r["events"], r["coalesced"], r["polls_per_s"], r["timeouts"]))
+    except subprocess.CalledProcessError as error:
+        return error.returncode
+    finally:
+        shutil.rmtree(directory)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+"""
+Local stand-ins for every notifier backend (see ESP8266/main/notifier.h), so the
+ESP8266 can be tested on the LAN without Discord or a real broker.
+
+    webhook  HTTP POST on --http-port (point SECRET_WEBHOOK at http://<host>:<port>/)
+    mqtt     minimal MQTT 3.1.1 broker on --mqtt-port (CONNECT, PUBLISH QoS 0, PING)
+    udp      datagrams on --udp-port
+    tcp      newline separated messages on --tcp-port
+    health   health summary datagrams on --health-udp-port
+
+Every message received is printed with its arrival time and backend. To exercise
+the retry path, --fail N makes the webhook and MQTT stand-ins reject their first N
+messages (HTTP 503, MQTT connection refused). TCP and UDP cannot report a failure
+once the message is written, so TCP is failed by refusing connections instead:
+--tcp-down S opens the TCP port only S seconds after start, and every connect
+before that is refused.
+
+usage:
+    standin_servers.py [--bind 0.0.0.0] [--http-port 8080] [--mqtt-port 1883]
+                       [--udp-port 5005] [--tcp-port 5006] [--health-udp-port 5007]
+                       [--fail N] [--tcp-down S]
+"""
+
+import argparse
+import http.server
+import socket
+import socketserver
+import sys
+import threading
+import time
+
+lock = threading.Lock()
+failures_left = {}
+
+
+def log(backend, peer, message):
+    with lock:
+        print("%s %-7s %-15s %s" % (time.strftime("%H:%M:%S"), backend, peer, message),
+              flush=True)
+
+
+def should_fail(backend):
+    with lock:
+        if failures_left.get(backend, 0) > 0:
+            failures_left[backend] -= 1
+            return True
+    return False
+
+
+class WebhookHandler(http.server.BaseHTTPRequestHandler):
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if should_fail("webhook"):
+            log("webhook", self.client_address[0], "rejected " + body.decode(errors="replace"))
+            self.send_response(503)
+        else:
+            log("webhook", self.client_address[0], body.decode(errors="replace"))
+            self.send_response(204)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, *args):
+        pass
+
+
+def read_exact(conn, n):
+    data = b""
+    while len(data) < n:
+        chunk = conn.recv(n - len(data))
+        if not chunk:
+            raise ConnectionError
+        data += chunk
+    return data
+
+
+def read_packet(conn):
+    header = read_exact(conn, 1)[0]
+    length, shift = 0, 0
+    while True:
+        digit = read_exact(conn, 1)[0]
+        length |= (digit & 0x7F) << shift
+        shift += 7
+        if not digit & 0x80:
+            break
+    return header, read_exact(conn, length)
+
+
+class MqttHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        peer = self.client_address[0]
+        try:
+            while True:
+                header, body = read_packet(self.request)
+                kind = header >> 4
+                if kind == 1:  # CONNECT
+                    refused = should_fail("mqtt")
+                    self.request.sendall(bytes([0x20, 2, 0, 3 if refused else 0]))
+                    log("mqtt", peer, "connect refused" if refused else "connected")
+                    if refused:
+                        return
+                elif kind == 3:  # PUBLISH
+                    topic_length = (body[0] << 8) | body[1]
+                    topic = body[2:2 + topic_length].decode(errors="replace")
+                    offset = 2 + topic_length + (2 if (header >> 1) & 3 else 0)
+                    log("mqtt", peer, "%s%s: %s" % (topic, " (retained)" if header & 1 else "",
+                                                    body[offset:].decode(errors="replace")))
+                elif kind == 12:  # PINGREQ
+                    self.request.sendall(bytes([0xD0, 0]))
+                elif kind == 14:  # DISCONNECT
+                    return
+        except ConnectionError:
+            pass
+
+
+class UdpHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        log("udp", self.client_address[0], self.request[0].decode(errors="replace"))
+
+
+class HealthHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        log("health", self.client_address[0], self.request[0].decode(errors="replace"))
+
+
+class TcpHandler(socketserver.StreamRequestHandler):
+    def handle(self):
+        peer = self.client_address[0]
+        for line in self.rfile:
+            log("tcp", peer, line.decode(errors="replace").rstrip("\n"))
+
+
+class ThreadingTCPServer(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+class ThreadingHTTPServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="notifier backend stand-ins")
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--http-port", type=int, default=8080)
+    parser.add_argument("--mqtt-port", type=int, default=1883)
+    parser.add_argument("--udp-port", type=int, default=5005)
+    parser.add_argument("--tcp-port", type=int, default=5006)
+    parser.add_argument("--health-udp-port", type=int, default=5007)
+    parser.add_argument("--fail", type=int, default=0, metavar="N",
+                        help="reject the first N webhook and MQTT messages")
+    parser.add_argument("--tcp-down", type=float, default=0, metavar="S",
+                        help="refuse TCP connections for the first S seconds")
+    args = parser.parse_args(argv[1:])
+
+    for backend in ("webhook", "mqtt"):
+        failures_left[backend] = args.fail
+
+    servers = [
+        ThreadingHTTPServer((args.bind, args.http_port), WebhookHandler),
+        ThreadingTCPServer((args.bind, args.mqtt_port), MqttHandler),
+        socketserver.ThreadingUDPServer((args.bind, args.udp_port), UdpHandler),
+        socketserver.ThreadingUDPServer((args.bind, args.health_udp_port), HealthHandler),
+    ]
+    for server in servers:
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    # nothing listens on the TCP port until then, so connects are refused
+    def open_tcp():
+        server = ThreadingTCPServer((args.bind, args.tcp_port), TcpHandler)
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        if args.tcp_down:
+            log("tcp", args.bind, "listening")
+    threading.Timer(args.tcp_down, open_tcp).start()
+
+    print("webhook http://%s:%d/  mqtt %d  udp %d  tcp %d  health %d" % (
+        socket.gethostname(), args.http_port, args.mqtt_port, args.udp_port, args.tcp_port,
+        args.health_udp_port), flush=True)
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))